@@ -0,0 +1,278 @@
+#include <CQCheckTree.h>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QPixmap>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// benchmark of core check tree operations at increasing tree sizes.
+//
+// Usage: CQCheckTreeBench [numNodes ...] (default 1000 100000 1000000)
+//
+// Each operation reports elapsed time and the number of heap allocations
+// (counted by the global operator new below). Run with QT_QPA_PLATFORM=offscreen
+// (the default if unset) so paint timings do not depend on a display.
+//
+// "add" builds the tree in a bulk update (one model reset) and "addRows" adds
+// up to 100000 checks one at a time (one row insert each) with the view
+// attached.
+
+namespace {
+
+std::atomic<size_t> s_numAllocs { 0 };
+
+}
+
+void *operator new(size_t size) {
+  ++s_numAllocs;
+
+  if (size == 0)
+    size = 1;
+
+  void *p = std::malloc(size);
+
+  if (! p)
+    throw std::bad_alloc();
+
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  std::free(p);
+}
+
+//---
+
+namespace {
+
+// time and allocations of a scoped operation
+class CQCheckTreeBenchTimer {
+ public:
+  CQCheckTreeBenchTimer(int numNodes, const char *name) :
+   numNodes_(numNodes), name_(name), numAllocs_(s_numAllocs.load()) {
+    timer_.start();
+  }
+
+ ~CQCheckTreeBenchTimer() {
+    double ms = double(timer_.nsecsElapsed())/1e6;
+
+    size_t numAllocs = s_numAllocs.load() - numAllocs_;
+
+    printf("%9d  %-16s %12.3f ms %12zu allocs\n", numNodes_, name_, ms, numAllocs);
+  }
+
+ private:
+  int           numNodes_  { 0 };
+  const char*   name_      { nullptr };
+  size_t        numAllocs_ { 0 };
+  QElapsedTimer timer_;
+};
+
+// populate tree with ~numNodes nodes: top sections of 10 sub sections of
+// 99 checks each
+std::vector<CQCheckTreeIndex>
+buildTree(CQCheckTree *tree, int numNodes)
+{
+  std::vector<CQCheckTreeIndex> sections;
+
+  tree->beginBulkUpdate();
+
+  tree->clear();
+
+  int n = 0;
+
+  for (int i = 0; n < numNodes; ++i) {
+    auto section = tree->addSection(QString("Section %1").arg(i));
+
+    sections.push_back(section);
+
+    ++n;
+
+    for (int j = 0; j < 10 && n < numNodes; ++j) {
+      auto subSection = tree->addSection(section, QString("Sub Section %1").arg(j));
+
+      ++n;
+
+      for (int k = 0; k < 99 && n < numNodes; ++k) {
+        tree->addCheck(subSection, QString("Check %1").arg(k));
+
+        ++n;
+      }
+    }
+  }
+
+  tree->endBulkUpdate();
+
+  return sections;
+}
+
+// add checks one at a time to an expanded section with the view attached so
+// each add is a separate row insert notification (no bulk update)
+void
+addRows(CQCheckTree *tree, int numChecks)
+{
+  auto *model = tree->model();
+
+  auto section = tree->addSection("Rows");
+
+  tree->tree()->expand(model->nodeModelIndex(model->treeIndexNode(section)));
+
+  for (int k = 0; k < numChecks; ++k)
+    tree->addCheck(section, QString("Check %1").arg(k));
+}
+
+void
+runBench(CQCheckTree *tree, int numNodes)
+{
+  auto *model = tree->model();
+
+  // per item adds with row inserts (capped as view updates make large sizes slow)
+  int numRows = std::min(numNodes, 100000);
+
+  tree->clear();
+
+  {
+  CQCheckTreeBenchTimer timer(numRows, "addRows");
+
+  addRows(tree, numRows);
+  }
+
+  std::vector<CQCheckTreeIndex> sections;
+
+  {
+  CQCheckTreeBenchTimer timer(numNodes, "add");
+
+  sections = buildTree(tree, numNodes);
+  }
+
+  int numModelNodes = model->numNodes();
+
+  // check then uncheck each top level section
+  {
+  CQCheckTreeBenchTimer timer(numNodes, "toggleSection");
+
+  for (const auto &section : sections)
+    tree->setItemChecked(section, true);
+
+  for (const auto &section : sections)
+    tree->setItemChecked(section, false);
+  }
+
+  // check every other section for checked items
+  for (size_t i = 0; i < sections.size(); i += 2)
+    tree->setItemChecked(sections[i], true);
+
+  {
+  CQCheckTreeBenchTimer timer(numNodes, "checkState");
+
+  int numChecked = 0;
+
+  for (int node = 1; node < numModelNodes; ++node)
+    if (model->checkState(node) == Qt::Checked)
+      ++numChecked;
+
+  (void) numChecked;
+  }
+
+  {
+  CQCheckTreeBenchTimer timer(numNodes, "getCheckedItems");
+
+  auto items = tree->getCheckedItems();
+
+  (void) items;
+  }
+
+  {
+  CQCheckTreeBenchTimer timer(numNodes, "hierName");
+
+  QString str;
+
+  for (int node = 1; node < numModelNodes; ++node) {
+    str.truncate(0);
+
+    model->appendHierName(node, str);
+  }
+  }
+
+  // expanded so column fit and paint visit all rows
+  tree->tree()->expandAll();
+
+  {
+  CQCheckTreeBenchTimer timer(numNodes, "fitColumns");
+
+  tree->invalidateColumnWidths();
+
+  tree->fitColumns();
+  }
+
+  {
+  CQCheckTreeBenchTimer timer(numNodes, "paint");
+
+  auto pixmap = tree->grab();
+
+  (void) pixmap;
+  }
+
+  {
+  CQCheckTreeBenchTimer timer(numNodes, "clear");
+
+  tree->clear();
+  }
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+
+  QApplication app(argc, argv);
+
+  std::vector<int> sizes;
+
+  for (int i = 1; i < argc; ++i) {
+    int n = atoi(argv[i]);
+
+    if (n > 0)
+      sizes.push_back(n);
+  }
+
+  if (sizes.empty())
+    sizes = { 1000, 100000, 1000000 };
+
+  auto *tree = new CQCheckTree;
+
+  tree->resize(800, 600);
+
+  tree->show();
+
+  for (auto numNodes : sizes)
+    runBench(tree, numNodes);
+
+  delete tree;
+
+  return 0;
+}
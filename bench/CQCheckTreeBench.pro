@@ -0,0 +1,25 @@
+TEMPLATE = app
+
+TARGET = CQCheckTreeBench
+
+DEPENDPATH += .
+
+QT += widgets
+
+CONFIG += release
+
+# Input
+SOURCES += \
+CQCheckTreeBench.cpp \
+
+DESTDIR     = .
+OBJECTS_DIR = .
+
+INCLUDEPATH += \
+../include \
+.
+
+unix:LIBS += \
+-L../lib \
+-lCQCheckTree \
+-lCQCheckTreeCore
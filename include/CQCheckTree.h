@@ -1,214 +1,48 @@
 #ifndef CQCheckTree_H
 #define CQCheckTree_H
 
-#include <QTreeWidget>
+#include <CQCheckTreeModel.h>
+#include <QTreeView>
+#include <QFrame>
 #include <vector>
+#include <map>
 
 class CQCheckTree;
-class CQCheckTreeCheck;
-
-struct CQCheckTreeIndex {
-  int sectionInd    { -1 };
-  int subSectionInd { -1 };
-  int itemInd       { -1 };
-
-  CQCheckTreeIndex() { }
-
-  CQCheckTreeIndex(int itemInd) :
-   itemInd(itemInd) {
-  }
-
-  CQCheckTreeIndex(int sectionInd, int itemInd) :
-   sectionInd(sectionInd), itemInd(itemInd) {
-  }
-
-  CQCheckTreeIndex(int sectionInd, int subSectionInd, int itemInd) :
-   sectionInd(sectionInd), subSectionInd(subSectionInd), itemInd(itemInd) {
-  }
-
-  friend bool operator<(const CQCheckTreeIndex &lhs, const CQCheckTreeIndex &rhs) {
-    return cmp(lhs, rhs) < 0;
-  }
-
-  static int cmp(const CQCheckTreeIndex &lhs, const CQCheckTreeIndex &rhs) {
-    if (lhs.sectionInd != rhs.sectionInd)
-      return (lhs.sectionInd > rhs.sectionInd ? 1 : -1);
-
-    if (lhs.subSectionInd != rhs.subSectionInd)
-      return (lhs.subSectionInd > rhs.subSectionInd ? 1 : -1);
-
-    if (lhs.itemInd != rhs.itemInd)
-      return (lhs.itemInd > rhs.itemInd ? 1 : -1);
-
-    return 0;
-  }
-};
-
-//---
-
-class CQCheckTreeItem : public QTreeWidgetItem {
- public:
-  CQCheckTreeItem(CQCheckTree *tree, int id);
-
-  virtual ~CQCheckTreeItem() { }
-
-  CQCheckTree *tree() const { return tree_; }
-
-  virtual QString hierName() const = 0;
-
-  int ind() const { return ind_; }
-  void setInd(int i) { ind_ = i; }
-
-  const CQCheckTreeIndex &index() const { return index_; }
-  void setIndex(const CQCheckTreeIndex &v) { index_ = v; }
-
-  QModelIndex modelIndex() const;
-
-  void updateCheck();
-
- protected:
-  CQCheckTree*     tree_ { nullptr };
-  int              ind_  { -1 };
-  CQCheckTreeIndex index_;
-};
+class CQCheckTreeDelegate;
+class CQCheckTreeFuzzyMatcher;
+struct CQCheckTreeFuzzyMatch;
+class QLineEdit;
 
 //---
 
-class CQCheckTreeSection : public CQCheckTreeItem {
- public:
-  using Items    = std::vector<CQCheckTreeItem *>;
-  using Sections = std::vector<CQCheckTreeSection *>;
-  using Checks   = std::vector<CQCheckTreeCheck *>;
-
- public:
-  enum { ITEM_ID = CQCheckTreeItem::UserType + 101 };
-
- public:
-  CQCheckTreeSection(CQCheckTree *tree, const QString &text);
-
-  virtual ~CQCheckTreeSection() { }
-
-  CQCheckTreeSection *section() const { return section_; }
-  void setSection(CQCheckTreeSection *section) { section_ = section; }
-
-  const QString &text() const { return text_; }
-
-  const Sections &sections() const { return sections_; }
-  const Checks &checks() const { return checks_; }
-
-  //---
-
-  QString hierName() const override;
-
-  //---
-
-  Qt::CheckState checkState() const;
-
-  void setChecked(bool checked);
-
-  int addSection(const QString &section);
-
-  CQCheckTreeCheck *addCheck(int sectionInd, const QString &name);
-
-  int addCheck(CQCheckTreeCheck *check);
-
-  uint numChecks() const { return uint(checks_.size()); }
-
-  QString getSectionText(int ind) const;
-
-  void updateInds(const QModelIndex &parent) const;
-
-  Items getAllItems() const;
-  Items getCheckedItems() const;
-
-  //---
-
-  QVariant data(int col, int role) const override {
-    if (role == Qt::ToolTipRole && col == 0)
-      return hierName();
-
-    return CQCheckTreeItem::data(col, role);
-  }
-
- private:
-  friend class CQCheckTree;
-  friend class CQCheckTreeCheck;
-
-  bool isItemChecked(int checkInd) const;
-  bool isItemChecked(int sectionInd, int checkInd) const;
-
-  void setItemChecked(int checkInd, bool checked);
-  void setItemChecked(int sectionInd, int checkInd, bool checked);
-
-  bool hasSection(int sectionInd) const;
-
-  QString getItemText(int sectionInd, int checkInd) const;
-  QString getItemText(int checkInd) const;
-
-  void emitChecked(CQCheckTreeCheck *check, bool checked);
-
-  int checkInd(CQCheckTreeCheck *) const;
-
- private:
-  CQCheckTreeSection *section_ { nullptr };
-  QString             text_;
-  Sections            sections_;
-  Checks              checks_;
-};
-
-//---
-
-class CQCheckTreeCheck : public CQCheckTreeItem {
- public:
-  enum { ITEM_ID = CQCheckTreeItem::UserType + 102 };
+class CQCheckTreeWidget : public QTreeView {
+  Q_OBJECT
 
  public:
-  CQCheckTreeCheck(CQCheckTree *tree, CQCheckTreeSection *section, const QString &text);
-
-  virtual ~CQCheckTreeCheck() { }
-
-  CQCheckTreeSection *section() const { return section_; }
-
-  const QString &text() const { return text_; }
-
-  //---
-
-  QString hierName() const override;
+  CQCheckTreeWidget(CQCheckTree *tree);
 
-  //---
+  void setHeaderLabels(const QStringList &labels);
 
-  bool isChecked() const { return checked_; }
-  void setChecked(bool checked);
+  QModelIndex checkIndex(const CQCheckTreeItem &item) const;
 
-  //---
+ protected:
+  void changeEvent(QEvent *e) override;
 
-  QVariant data(int col, int role) const override {
-    if (role == Qt::ToolTipRole && col == 0)
-      return hierName();
+  // changed rows are repainted once per event loop iteration (see flushUpdates)
+  void dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight,
+                   const QVector<int> &roles=QVector<int>()) override;
 
-    return CQCheckTreeItem::data(col, role);
-  }
+ private Q_SLOTS:
+  void flushUpdates();
 
  private:
-  CQCheckTreeSection *section_ { nullptr };
-  QString             text_;
-  bool                checked_ { false };
-};
+  using RowRange  = std::pair<int, int>;
+  using DirtyRows = std::map<int, RowRange>; // parent node -> changed rows
 
-//---
-
-class CQCheckTreeWidget : public QTreeWidget {
-  Q_OBJECT
-
- public:
-  CQCheckTreeWidget(CQCheckTree *tree);
-
-  void setHeaderLabels(const QStringList &labels);
-
-  QModelIndex checkIndex(const CQCheckTreeItem *item);
-
- private:
-  CQCheckTree *tree_ { nullptr };
+  CQCheckTree         *tree_         { nullptr };
+  CQCheckTreeDelegate *delegate_     { nullptr };
+  DirtyRows            dirtyRows_;
+  bool                 flushPending_ { false };
 };
 
 //---
@@ -220,9 +54,7 @@ class CQCheckTree : public QFrame {
   Q_PROPERTY(bool autoFit   READ isAutoFit WRITE setAutoFit)
 
  public:
-  using Items    = std::vector<CQCheckTreeItem *>;
-  using Sections = std::vector<CQCheckTreeSection *>;
-  using Checks   = std::vector<CQCheckTreeCheck *>;
+  using Items = CQCheckTreeModel::Items;
 
  public:
   CQCheckTree(QWidget *parent=nullptr);
@@ -230,17 +62,20 @@ class CQCheckTree : public QFrame {
 
   CQCheckTreeWidget *tree() const { return tree_; }
 
+  CQCheckTreeModel *model() const { return model_; }
+
   int checkSize() const { return checkSize_; }
   void setCheckSize(int i) { checkSize_ = i; }
 
   bool isAutoFit() const { return autoFit_; }
   void setAutoFit(bool b) { autoFit_ = b; }
 
-  const QChar &hierSep() const { return hierSep_; }
-  void setHierSep(const QChar &v) { hierSep_ = v; }
+  const QChar &hierSep() const { return model_->hierSep(); }
+  void setHierSep(const QChar &v) { model_->setHierSep(v); }
 
-  const Sections &sections() const { return sections_; }
-  const Checks &checks() const { return checks_; }
+  // provider of lazy section children (not owned)
+  CQCheckTreeProvider *provider() const { return model_->provider(); }
+  void setProvider(CQCheckTreeProvider *provider) { model_->setProvider(provider); }
 
   //---
 
@@ -248,20 +83,50 @@ class CQCheckTree : public QFrame {
 
   void clear();
 
-  // add section
+  // add section (index can be a section at any depth)
   CQCheckTreeIndex addSection(const QString &section);
   CQCheckTreeIndex addSection(const CQCheckTreeIndex &ind, const QString &section);
   CQCheckTreeIndex addSection(int sectionInd, const QString &section);
 
-  // add check
+  // add check (index can be a section at any depth)
   CQCheckTreeIndex addCheck(const QString &name);
   CQCheckTreeIndex addCheck(const CQCheckTreeIndex &ind, const QString &name);
   CQCheckTreeIndex addCheck(int subSectionInd, const QString &name);
   CQCheckTreeIndex addCheck(int sectionInd, int subSectionInd, const QString &name);
 
+  // add consecutive checks to section (returns index of first check)
+  CQCheckTreeIndex addChecks(const CQCheckTreeIndex &ind, const QStringList &names);
+
+  // add check from path of section names separated by hierSep (missing sections are added)
+  CQCheckTreeIndex addCheckPath(const QString &path);
+
+  // add checks from paths (single reset of empty tree, otherwise one row
+  // insert per parent section so expansion and scroll state are kept)
+  void addCheckPaths(const QStringList &paths);
+
+  // update tree to check paths keeping check and expansion state of existing
+  // items (only changed items are added, removed or moved)
+  void setContents(const QStringList &paths);
+
+  // add section whose children are fetched from the provider when expanded
+  CQCheckTreeIndex addLazySection(const CQCheckTreeIndex &ind, const QString &section);
+
+  // remove check, section (with its subtree) or consecutive child rows of section
+  // (later siblings move up so their indices change)
+  bool removeCheck(const CQCheckTreeIndex &ind);
+  bool removeSection(const CQCheckTreeIndex &ind);
+  bool removeRange(const CQCheckTreeIndex &ind, int row, int count);
+
+  // bulk population (defer model notifications and column fit until end)
+  void beginBulkUpdate();
+  void endBulkUpdate();
+
   bool isItemChecked(const CQCheckTreeIndex &ind) const;
   void setItemChecked(const CQCheckTreeIndex &ind, bool checked);
 
+  // set checked state of several items as a single change (itemsChecked signal)
+  void setItemsChecked(const std::vector<CQCheckTreeIndex> &inds, bool checked);
+
   bool hasSection(const CQCheckTreeIndex &ind) const;
 
   QString getSectionText(const CQCheckTreeIndex &ind) const;
@@ -270,54 +135,163 @@ class CQCheckTree : public QFrame {
 
   QString getItemText(const CQCheckTreeIndex &ind) const;
 
+  CQCheckTreeItem getItem(const CQCheckTreeIndex &ind) const;
+
   Items getAllItems() const;
   Items getCheckedItems() const;
 
+  // iterate all/checked items without building a list
+  CQCheckTreeItemRange items() const { return model_->items(); }
+  CQCheckTreeItemRange checkedItems() const { return model_->checkedItems(); }
+
+  // call f(item) for all/checked items until it returns false
+  template<typename F>
+  bool forEachItem(F f) const { return model_->forEachItem(f); }
+
+  template<typename F>
+  bool forEachChecked(F f) const { return model_->forEachChecked(f); }
+
+  // filter text (see setFilter)
+  const QString &filter() const { return filter_; }
+
+  // show filter text edit above tree
+  bool isFilterVisible() const;
+  void setFilterVisible(bool b);
+
+  // filter shows best fuzzy matches of hierarchical names (matched in background)
+  bool isFilterFuzzy() const { return filterFuzzy_; }
+  void setFilterFuzzy(bool b);
+
+  int maxFuzzyMatches() const { return maxFuzzyMatches_; }
+  void setMaxFuzzyMatches(int n) { maxFuzzyMatches_ = n; }
+
+  // save/restore check state (restore sends a single itemsChecked per state)
+  bool saveState(QIODevice &dev) const { return model_->saveState(dev); }
+  bool restoreState(QIODevice &dev) { return model_->restoreState(dev); }
+
+  // immutable snapshot of structure and check state for other threads
+  // (see CQCheckTreeSnapshot, null unless enabled)
+  bool isSnapshotsEnabled() const { return model_->isSnapshotsEnabled(); }
+  void setSnapshotsEnabled(bool b) { model_->setSnapshotsEnabled(b); }
+
+  CQCheckTreeModel::SnapshotP snapshot() const { return model_->snapshot(); }
+
+  // runtime counters of model and view work (zero when disabled)
+  bool isStatsEnabled() const { return model_->isStatsEnabled(); }
+  void setStatsEnabled(bool b) { model_->setStatsEnabled(b); }
+
+  CQCheckTreeStats stats() const;
+
+  void resetStats() { model_->resetStats(); }
+
+  // stats counter (null when disabled)
+  CQCheckTreeStats::Counter *statsCounter(CQCheckTreeStats::Counter CQCheckTreeStats::*c) const {
+    auto *stats = model_->stats();
+
+    return (stats ? &(stats->*c) : nullptr);
+  }
+
+  // discard cached label widths used to fit columns (font changed)
+  void invalidateColumnWidths();
+
   void paintEvent(QPaintEvent *e) override;
   void resizeEvent(QResizeEvent *e) override;
 
  private:
-  friend class CQCheckTreeSection;
-  friend class CQCheckTreeDelegate;
-  friend class CQCheckTreeCheck;
+  void autoFit();
 
-  CQCheckTreeItem *getModelItem(const QModelIndex &index) const;
+  void updateClipWidth();
 
-  void emitChecked(CQCheckTreeSection *section, int itemNum, bool checked);
+  void updateColumnWidths();
 
-  void autoFit();
+  void addVisibleWidths(int node, bool add);
+  void addRowWidth(int node, bool add);
 
-  void updateClipWidth();
+  bool isNodeVisible(int node) const;
+
+  void applyFilter();
 
  public Q_SLOTS:
   void expandAll();
   void collapseAll();
   void fitColumns();
 
+  // undo/redo last check change
+  void undo();
+  void redo();
+
+  // hide rows whose label does not contain text (case insensitive) unless an
+  // ancestor section matches (ancestors of matching rows are kept visible)
+  void setFilter(const QString &text);
+
  private Q_SLOTS:
   void itemClicked(const QModelIndex &index);
 
+  void nodeCheckedSlot(int node, bool checked);
+  void nodesCheckedSlot(const QVector<int> &nodes, bool checked);
+
   void customContextMenuSlot(const QPoint &pos);
+  void menuActionSlot();
+
+  void rowsInsertedSlot(const QModelIndex &parent, int first, int last);
+  void rowsAboutToBeRemovedSlot(const QModelIndex &parent, int first, int last);
+  void rowsRemovedSlot();
+  void modelResetSlot();
+
+  void expandedSlot(const QModelIndex &index);
+  void collapsedSlot(const QModelIndex &index);
+
+  void fuzzyMatchedSlot(const QVector<CQCheckTreeFuzzyMatch> &matches);
+
+  void filterInsertedSlot();
 
  Q_SIGNALS:
+  // single check changed
   void itemChecked(const CQCheckTreeIndex &ind, bool checked);
 
+  // set of checks changed by section toggle or setItemsChecked
+  void itemsChecked(const QVector<CQCheckTreeIndex> &inds, bool checked);
+
   void sectionClicked(int sectionInd);
   void subSectionClicked(int sectionInd, int subSectionInd);
+  void sectionIndexClicked(const CQCheckTreeIndex &ind); // section at any depth
   void itemClicked(const CQCheckTreeIndex &ind);
 
+  // context menu action triggered (name of tree slot invoked)
+  void menuActionTriggered(const QString &name);
+
  private:
-  CQCheckTreeWidget *tree_      { nullptr };
+  CQCheckTreeModel*  model_     { nullptr };
+  CQCheckTreeWidget* tree_      { nullptr };
   int                checkSize_ { 12 };
   bool               autoFit_   { true };
   bool               needsFit_  { true };
-  Sections           sections_;
-  Checks             checks_;
   QPoint             menuPos_;
   int                fitSize0_  { -1 };
   int                fitSize1_  { -1 };
   int                clipWidth_ { -1 };
-  QChar              hierSep_   { '/' };
+
+  // column 0 width is tracked incrementally from the widths of visible rows
+  using NodeWidths  = std::vector<int>;
+  using WidthCounts = std::map<int, int>;
+
+  NodeWidths  labelWidths_;          // cached text width per node (-1 if not measured)
+  NodeWidths  rowWidths_;            // width counted per visible row (-1 if not counted)
+  WidthCounts widthCounts_;          // number of visible rows per row width
+  bool        widthsValid_ { false };
+
+  // filter
+  QLineEdit*       filterEdit_ { nullptr };
+  QString          filter_;
+  std::vector<int> filterMatches_; // nodes matching filter
+  std::vector<int> hiddenNodes_;   // nodes of hidden rows
+  std::vector<int> insertedNodes_; // inserted nodes not yet filtered
+  bool             filterInsertedPending_ { false };
+
+  // fuzzy filter
+  bool                     filterFuzzy_     { false };
+  int                      maxFuzzyMatches_ { 1000 };
+  CQCheckTreeFuzzyMatcher* matcher_         { nullptr };
 };
 
 #endif
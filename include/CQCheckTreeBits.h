@@ -0,0 +1,179 @@
+#ifndef CQCheckTreeBits_H
+#define CQCheckTreeBits_H
+
+#include <QtAlgorithms>
+#include <algorithm>
+#include <vector>
+#include <cassert>
+
+// packed dynamic bitset (64 bit words, unused bits of last word always zero)
+class CQCheckTreeBits {
+ public:
+  using Word  = quint64;
+  using Words = std::vector<Word>;
+
+  enum { WORD_BITS = 64 };
+
+ public:
+  CQCheckTreeBits() { }
+
+  int size() const { return size_; }
+
+  bool isEmpty() const { return size_ == 0; }
+
+  const Words &words() const { return words_; }
+
+  void clear() {
+    words_.clear();
+
+    size_ = 0;
+  }
+
+  void resize(int n) {
+    words_.resize(numWords(n), Word(0));
+
+    size_ = n;
+
+    maskTail();
+  }
+
+  bool test(int i) const {
+    return (words_[wordInd(i)] >> (i & (WORD_BITS - 1))) & 1;
+  }
+
+  void set(int i, bool b) {
+    auto mask = bitMask(i);
+
+    if (b)
+      words_[wordInd(i)] |= mask;
+    else
+      words_[wordInd(i)] &= ~mask;
+  }
+
+  // set word (unused bits of last word are cleared)
+  void setWord(size_t i, Word w) {
+    words_[i] = w;
+
+    if (i == words_.size() - 1)
+      maskTail();
+  }
+
+  // set all bits (word fill)
+  void fill(bool b) {
+    std::fill(words_.begin(), words_.end(), b ? ~Word(0) : Word(0));
+
+    maskTail();
+  }
+
+  // remove n bits at i (later bits shift down)
+  void erase(int i, int n) {
+    assert(i >= 0 && n >= 0 && i + n <= size_);
+
+    for (int j = i; j + n < size_; ++j)
+      set(j, test(j + n));
+
+    resize(size_ - n);
+  }
+
+  // number of set bits
+  int count() const {
+    int n = 0;
+
+    for (auto w : words_)
+      n += int(qPopulationCount(w));
+
+    return n;
+  }
+
+  // index of first set bit at or after i (-1 if none)
+  int findNext(int i) const {
+    if (i < 0) i = 0;
+
+    if (i >= size_)
+      return -1;
+
+    auto wi = wordInd(i);
+
+    Word w = words_[wi] & (~Word(0) << (i & (WORD_BITS - 1)));
+
+    while (true) {
+      if (w)
+        return int(wi*WORD_BITS + qCountTrailingZeroBits(w));
+
+      if (++wi >= words_.size())
+        return -1;
+
+      w = words_[wi];
+    }
+  }
+
+  // call f(i) for each set bit
+  template<typename F>
+  void forEachSet(F f) const {
+    forEachWord(Word(0), f);
+  }
+
+  // call f(i) for each bit which is not equal to b
+  template<typename F>
+  void forEachDiff(bool b, F f) const {
+    forEachWord(b ? ~Word(0) : Word(0), f);
+  }
+
+  // call f(i) for each bit which differs from same size bitset
+  template<typename F>
+  void forEachDiff(const CQCheckTreeBits &b, F f) const {
+    assert(b.size_ == size_);
+
+    // unused bits of last words are zero in both
+    for (size_t wi = 0; wi < words_.size(); ++wi)
+      forEachBit(wi, words_[wi] ^ b.words_[wi], f);
+  }
+
+ private:
+  static size_t numWords(int n) { return size_t((n + WORD_BITS - 1)/WORD_BITS); }
+
+  static size_t wordInd(int i) { return size_t(i/WORD_BITS); }
+
+  static Word bitMask(int i) { return Word(1) << (i & (WORD_BITS - 1)); }
+
+  void maskTail() {
+    int r = size_ & (WORD_BITS - 1);
+
+    if (r && ! words_.empty())
+      words_.back() &= (Word(1) << r) - 1;
+  }
+
+  template<typename F>
+  void forEachWord(Word x, F f) const {
+    auto nw = words_.size();
+
+    for (size_t wi = 0; wi < nw; ++wi) {
+      Word w = words_[wi] ^ x;
+
+      // ignore unused bits of last word
+      if (wi == nw - 1) {
+        int r = size_ & (WORD_BITS - 1);
+
+        if (r)
+          w &= (Word(1) << r) - 1;
+      }
+
+      forEachBit(wi, w, f);
+    }
+  }
+
+  template<typename F>
+  static void forEachBit(size_t wi, Word w, F f) {
+    while (w) {
+      f(int(wi*WORD_BITS + qCountTrailingZeroBits(w)));
+
+      w &= w - 1;
+    }
+  }
+
+ private:
+  Words words_;
+  int   size_ { 0 };
+};
+
+#endif
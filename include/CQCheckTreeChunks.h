@@ -0,0 +1,89 @@
+#ifndef CQCheckTreeChunks_H
+#define CQCheckTreeChunks_H
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+// vector stored as fixed size blocks which are shared between copies.
+//
+// Copying only copies the block pointers and a block is copied when it is
+// first written through a copy which shares it, so a copy modified at a few
+// indices only allocates the blocks containing those indices. Blocks are
+// never modified while shared so copies can be read from other threads.
+template<typename T, int BLOCK_BITS=8>
+class CQCheckTreeChunks {
+ public:
+  enum { BLOCK_SIZE = 1 << BLOCK_BITS };
+
+  using Block  = std::vector<T>;
+  using BlockP = std::shared_ptr<Block>;
+  using Blocks = std::vector<BlockP>;
+
+ public:
+  CQCheckTreeChunks() { }
+
+  size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  const T &operator[](size_t i) const {
+    return (*blocks_[i >> BLOCK_BITS])[i & (BLOCK_SIZE - 1)];
+  }
+
+  // writable value (copies block if shared)
+  T &ref(size_t i) {
+    assert(i < size_);
+
+    return writeBlock(i >> BLOCK_BITS)[i & (BLOCK_SIZE - 1)];
+  }
+
+  void push_back(const T &t) {
+    if ((size_ & (BLOCK_SIZE - 1)) == 0) {
+      blocks_.push_back(std::make_shared<Block>());
+
+      blocks_.back()->reserve(BLOCK_SIZE);
+    }
+
+    writeBlock(size_ >> BLOCK_BITS).push_back(t);
+
+    ++size_;
+  }
+
+  // grow to n values
+  void resize(size_t n) {
+    while (size_ < n)
+      push_back(T());
+
+    assert(size_ == n);
+  }
+
+  void clear() {
+    blocks_.clear();
+
+    size_ = 0;
+  }
+
+ private:
+  Block &writeBlock(size_t b) {
+    auto &block = blocks_[b];
+
+    // only this copy references block so it can't be read elsewhere
+    if (block.use_count() > 1)
+      block = std::make_shared<Block>(*block);
+    else {
+      // use_count is a relaxed load so order writes after the reads of a
+      // reader thread which released the block
+      std::atomic_thread_fence(std::memory_order_acquire);
+    }
+
+    return *block;
+  }
+
+ private:
+  Blocks blocks_;
+  size_t size_ { 0 };
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef CQCheckTreeFuzzyMatcher_H
+#define CQCheckTreeFuzzyMatcher_H
+
+#include <CQCheckTreeModel.h>
+#include <QObject>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QVector>
+
+// fuzzy match result
+struct CQCheckTreeFuzzyMatch {
+  int node  { -1 };
+  int score { 0 };
+
+  CQCheckTreeFuzzyMatch() { }
+
+  CQCheckTreeFuzzyMatch(int node, int score) :
+   node(node), score(score) {
+  }
+};
+
+Q_DECLARE_METATYPE(CQCheckTreeFuzzyMatch)
+
+//---
+
+// fuzzy matcher of hierarchical names.
+//
+// Query parts (split by the model's hier separator) must match, in order, the
+// label of a node (last part) and the labels of its ancestors as character
+// subsequences (e.g. "net/tcp/rt" matches "network/tcp/retransmits").
+//
+// Scoring runs on a worker thread over a structure snapshot of the model. A new
+// query cancels the running one and only the top matches of the latest query
+// are sent (queued) by the matched signal.
+class CQCheckTreeFuzzyMatcher : public QObject {
+  Q_OBJECT
+
+ public:
+  using Matches = QVector<CQCheckTreeFuzzyMatch>;
+
+ public:
+  CQCheckTreeFuzzyMatcher(CQCheckTreeModel *model);
+ ~CQCheckTreeFuzzyMatcher();
+
+  CQCheckTreeModel *model() const { return model_; }
+
+  // start matching text (results sent by matched signal)
+  void match(const QString &text, int maxMatches);
+
+  // cancel running query
+  void cancel();
+
+  // is generation the latest query
+  bool isCurrent(int generation) const { return generation_.loadAcquire() == generation; }
+
+  // score of label matching lower case text as subsequence (-1 if no match)
+  static int matchScore(const QChar *label, int len, const QString &text);
+
+ Q_SIGNALS:
+  // top matches of latest query (best first)
+  void matched(const QVector<CQCheckTreeFuzzyMatch> &matches);
+
+  // results of worker (queued to resultsSlot)
+  void resultsReady(int generation, const QVector<CQCheckTreeFuzzyMatch> &matches);
+
+ private Q_SLOTS:
+  void resultsSlot(int generation, const QVector<CQCheckTreeFuzzyMatch> &matches);
+
+ private:
+  CQCheckTreeModel* model_ { nullptr };
+  QThreadPool       pool_;             // single worker thread
+  QAtomicInt        generation_ { 0 }; // latest query
+};
+
+#endif
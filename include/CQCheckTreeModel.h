@@ -0,0 +1,952 @@
+#ifndef CQCheckTreeModel_H
+#define CQCheckTreeModel_H
+
+#include <CQCheckTreeBits.h>
+#include <CQCheckTreeChunks.h>
+#include <CQCheckTreeSearchIndex.h>
+#include <CQCheckTreeStats.h>
+#include <QAbstractItemModel>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+
+class CQCheckTreeModel;
+class CQCheckTreeProvider;
+class CQCheckTreeSnapshot;
+class QIODevice;
+
+// index of section or check in tree.
+//
+// The section path is stored as the top level section index, the second level
+// section index and, for deeper trees only, the remaining levels in a heap
+// array (null for one and two level paths so the common index is three ints
+// and a pointer). The item index is the check index in the innermost section
+// (-1 for the section itself).
+struct CQCheckTreeIndex {
+  // int array allocated only when not empty
+  class Inds {
+   public:
+    Inds() { }
+
+    Inds(const Inds &rhs) {
+      assign(rhs);
+    }
+
+    Inds(Inds &&rhs) noexcept :
+     inds_(rhs.inds_) {
+      rhs.inds_ = nullptr;
+    }
+
+   ~Inds() {
+      delete [] inds_;
+    }
+
+    Inds &operator=(const Inds &rhs) {
+      if (this != &rhs) {
+        delete [] inds_;
+
+        inds_ = nullptr;
+
+        assign(rhs);
+      }
+
+      return *this;
+    }
+
+    Inds &operator=(Inds &&rhs) noexcept {
+      std::swap(inds_, rhs.inds_);
+
+      return *this;
+    }
+
+    int size() const { return (inds_ ? inds_[0] : 0); }
+
+    int operator[](int i) const { return inds_[i + 1]; }
+
+    int &operator[](int i) { return inds_[i + 1]; }
+
+    // resize (new values are zero)
+    void resize(int n) {
+      int size = this->size();
+
+      if (n == size)
+        return;
+
+      int *inds = nullptr;
+
+      if (n > 0) {
+        inds = new int [size_t(n) + 1];
+
+        inds[0] = n;
+
+        for (int i = 0; i < n; ++i)
+          inds[i + 1] = (i < size ? inds_[i + 1] : 0);
+      }
+
+      delete [] inds_;
+
+      inds_ = inds;
+    }
+
+   private:
+    void assign(const Inds &rhs) {
+      if (! rhs.inds_)
+        return;
+
+      int n = rhs.size();
+
+      inds_ = new int [size_t(n) + 1];
+
+      std::copy(rhs.inds_, rhs.inds_ + n + 1, inds_);
+    }
+
+   private:
+    int *inds_ { nullptr }; // size followed by values (null if empty)
+  };
+
+  int  sectionInd    { -1 }; // top level section
+  int  subSectionInd { -1 }; // second level section
+  int  itemInd       { -1 }; // check in innermost section
+  Inds subInds;              // third and deeper level sections
+
+  CQCheckTreeIndex() { }
+
+  CQCheckTreeIndex(int itemInd) :
+   itemInd(itemInd) {
+  }
+
+  CQCheckTreeIndex(int sectionInd, int itemInd) :
+   sectionInd(sectionInd), itemInd(itemInd) {
+  }
+
+  CQCheckTreeIndex(int sectionInd, int subSectionInd, int itemInd) :
+   sectionInd(sectionInd), subSectionInd(subSectionInd), itemInd(itemInd) {
+  }
+
+  CQCheckTreeIndex(const std::vector<int> &sectionPath, int itemInd) :
+   itemInd(itemInd) {
+    setDepth(int(sectionPath.size()));
+
+    for (size_t i = 0; i < sectionPath.size(); ++i)
+      setSectionPathInd(int(i), sectionPath[i]);
+  }
+
+  // number of section levels
+  int depth() const {
+    if (sectionInd    < 0) return 0;
+    if (subSectionInd < 0) return 1;
+
+    return 2 + subInds.size();
+  }
+
+  void setDepth(int depth) {
+    if (depth < 1) sectionInd    = -1;
+    if (depth < 2) subSectionInd = -1;
+
+    subInds.resize(std::max(depth - 2, 0));
+  }
+
+  // section index at level
+  int sectionPathInd(int level) const {
+    if (level == 0) return sectionInd;
+    if (level == 1) return subSectionInd;
+
+    return subInds[level - 2];
+  }
+
+  void setSectionPathInd(int level, int ind) {
+    if      (level == 0) sectionInd    = ind;
+    else if (level == 1) subSectionInd = ind;
+    else                 subInds[level - 2] = ind;
+  }
+
+  // index of innermost section
+  CQCheckTreeIndex sectionIndex() const {
+    auto ind = *this;
+
+    ind.itemInd = -1;
+
+    return ind;
+  }
+
+  // index of child section of innermost section
+  CQCheckTreeIndex childSectionIndex(int ind) const {
+    auto ind1 = sectionIndex();
+
+    int depth = ind1.depth();
+
+    ind1.setDepth(depth + 1);
+
+    ind1.setSectionPathInd(depth, ind);
+
+    return ind1;
+  }
+
+  friend bool operator<(const CQCheckTreeIndex &lhs, const CQCheckTreeIndex &rhs) {
+    return cmp(lhs, rhs) < 0;
+  }
+
+  friend bool operator==(const CQCheckTreeIndex &lhs, const CQCheckTreeIndex &rhs) {
+    return cmp(lhs, rhs) == 0;
+  }
+
+  friend bool operator!=(const CQCheckTreeIndex &lhs, const CQCheckTreeIndex &rhs) {
+    return cmp(lhs, rhs) != 0;
+  }
+
+  static int cmp(const CQCheckTreeIndex &lhs, const CQCheckTreeIndex &rhs) {
+    if (lhs.sectionInd != rhs.sectionInd)
+      return (lhs.sectionInd > rhs.sectionInd ? 1 : -1);
+
+    if (lhs.subSectionInd != rhs.subSectionInd)
+      return (lhs.subSectionInd > rhs.subSectionInd ? 1 : -1);
+
+    int n1 = lhs.subInds.size();
+    int n2 = rhs.subInds.size();
+
+    for (int i = 0; i < std::min(n1, n2); ++i) {
+      if (lhs.subInds[i] != rhs.subInds[i])
+        return (lhs.subInds[i] > rhs.subInds[i] ? 1 : -1);
+    }
+
+    if (n1 != n2)
+      return (n1 > n2 ? 1 : -1);
+
+    if (lhs.itemInd != rhs.itemInd)
+      return (lhs.itemInd > rhs.itemInd ? 1 : -1);
+
+    return 0;
+  }
+};
+
+// deep levels are owned through a pointer so index vectors can relocate with memcpy
+Q_DECLARE_TYPEINFO(CQCheckTreeIndex, Q_MOVABLE_TYPE);
+
+//---
+
+// lightweight handle to a section or check node of a model
+class CQCheckTreeItem {
+ public:
+  CQCheckTreeItem() { }
+
+  CQCheckTreeItem(const CQCheckTreeModel *model, int node) :
+   model_(model), node_(node) {
+  }
+
+  const CQCheckTreeModel *model() const { return model_; }
+
+  int node() const { return node_; }
+
+  bool isValid() const { return model_ && node_ >= 0; }
+
+  bool isSection() const;
+
+  QString text() const;
+
+  QString hierName() const;
+
+  void appendHierName(QString &str) const;
+
+  Qt::CheckState checkState() const;
+
+  bool isChecked() const;
+
+  CQCheckTreeIndex index() const;
+
+  friend bool operator==(const CQCheckTreeItem &lhs, const CQCheckTreeItem &rhs) {
+    return (lhs.model_ == rhs.model_ && lhs.node_ == rhs.node_);
+  }
+
+ private:
+  const CQCheckTreeModel *model_ { nullptr };
+  int                     node_  { -1 };
+};
+
+//---
+
+// forward iterator over all or checked items of a model in getAllItems order.
+// Walks the node tree in place (no allocation) and, for checked items, skips
+// unchecked sections and jumps between set check bits.
+class CQCheckTreeItemIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type        = CQCheckTreeItem;
+  using difference_type   = std::ptrdiff_t;
+  using pointer           = const CQCheckTreeItem *;
+  using reference         = CQCheckTreeItem;
+
+ public:
+  CQCheckTreeItemIterator() { }
+
+  CQCheckTreeItemIterator(const CQCheckTreeModel *model, int node, bool checked) :
+   model_(model), node_(node), checked_(checked) {
+  }
+
+  CQCheckTreeItem operator*() const { return CQCheckTreeItem(model_, node_); }
+
+  CQCheckTreeItemIterator &operator++();
+
+  CQCheckTreeItemIterator operator++(int) {
+    auto i = *this;
+
+    ++(*this);
+
+    return i;
+  }
+
+  friend bool operator==(const CQCheckTreeItemIterator &lhs, const CQCheckTreeItemIterator &rhs) {
+    return (lhs.node_ == rhs.node_);
+  }
+
+  friend bool operator!=(const CQCheckTreeItemIterator &lhs, const CQCheckTreeItemIterator &rhs) {
+    return (lhs.node_ != rhs.node_);
+  }
+
+ private:
+  const CQCheckTreeModel *model_   { nullptr };
+  int                     node_    { -1 }; // -1 at end
+  bool                    checked_ { false };
+};
+
+// range of item iterators (for range-for)
+class CQCheckTreeItemRange {
+ public:
+  CQCheckTreeItemRange(const CQCheckTreeItemIterator &begin) :
+   begin_(begin) {
+  }
+
+  const CQCheckTreeItemIterator &begin() const { return begin_; }
+
+  CQCheckTreeItemIterator end() const { return CQCheckTreeItemIterator(); }
+
+ private:
+  CQCheckTreeItemIterator begin_;
+};
+
+//---
+
+// item model storing sections and checks in flat node arrays.
+//
+// Each node is a small fixed size record (parent, row, label offset, flags) and
+// all labels share a single string buffer. Sections additionally store their
+// child node lists, the checked state of their child checks as packed bits
+// (indexed by check index) and aggregate check counts.
+class CQCheckTreeModel : public QAbstractItemModel {
+  Q_OBJECT
+
+ public:
+  enum { ROOT_NODE = 0 };
+
+  enum Column {
+    TEXT_COLUMN  = 0,
+    CHECK_COLUMN = 1
+  };
+
+  using Items = std::vector<CQCheckTreeItem>;
+
+  // immutable copy of node structure and labels (for use in other threads)
+  struct StructureNode {
+    int  parent      { -1 };
+    int  ind         { -1 }; // index in parent sections or checks
+    int  section     { -1 }; // section index (section nodes only)
+    uint labelOffset { 0 };
+    uint labelLength { 0 };
+    bool removed     { false };
+  };
+
+  struct StructureSection {
+    int              node { -1 }; // section node
+    std::vector<int> sections;    // child section nodes
+    std::vector<int> checks;   // child check nodes
+  };
+
+  // node and section arrays share unchanged blocks with previous snapshots
+  struct StructureSnapshot {
+    CQCheckTreeChunks<StructureNode>    nodes;
+    CQCheckTreeChunks<StructureSection> sections;
+    QString                             labels; // shared with model until model adds labels
+  };
+
+  using StructureSnapshotP = std::shared_ptr<const StructureSnapshot>;
+
+  using SnapshotP = std::shared_ptr<const CQCheckTreeSnapshot>;
+
+ public:
+  CQCheckTreeModel(QObject *parent=nullptr);
+
+ ~CQCheckTreeModel();
+
+  const QChar &hierSep() const { return hierSep_; }
+  void setHierSep(const QChar &v);
+
+  const QStringList &headers() const { return headers_; }
+  void setHeaders(const QStringList &headers);
+
+  //---
+
+  void clear();
+
+  // pre-allocate storage for nodes and label characters
+  void reserve(int numNodes, int numChars);
+
+  // release node, label and section storage kept by clear for rebuilds
+  void squeeze();
+
+  // add section/check node to parent section node (returns new node)
+  int addSection(int parent, const QString &text);
+  int addCheck  (int parent, const QString &text);
+
+  // add consecutive checks to parent section node (returns first new node,
+  // later node ids are only consecutive if no removed ids are reused)
+  int addChecks(int parent, const QStringList &texts);
+
+  // add check from hierarchical path (sections separated by hierSep),
+  // creating missing sections (returns new node)
+  int addCheckPath(const QString &path);
+
+  // add checks from paths. An empty model is populated in a single bulk
+  // update, otherwise missing sections are added then the checks of each
+  // parent section are added in a single row insert.
+  void addCheckPaths(const QStringList &paths);
+
+  // section node of hierarchical path (created if missing, root for empty path)
+  int pathSection(const QString &path);
+
+  // remove check, section (and its subtree) or consecutive child rows of
+  // section node. Later siblings move up (rows and indices are compacted) and
+  // views get a single row remove per call. Removed node ids are invalid
+  // and are reused by later adds (as are their section and label storage).
+  // Undo steps follow the compacted check indices (changes of removed checks
+  // are dropped).
+  bool removeCheck  (int node);
+  bool removeSection(int node);
+  bool removeRange  (int parent, int row, int count);
+
+  // move child row of section node to new row (check state and undo steps are kept)
+  bool moveRow(int parent, int row, int newRow);
+
+  // reconcile tree with check paths (sections separated by hierSep). Children
+  // are matched by label so only missing nodes are added, unmatched nodes
+  // removed and reordered nodes moved, keeping the check state of matched
+  // nodes (and the view's expansion state). Sections without checks in paths
+  // are removed. Moved children of all sections are reordered in a single
+  // layout change. Unfetched lazy sections stay unfetched if the provider's
+  // child count matches the wanted child count (their children are not
+  // compared), otherwise they are fetched and reconciled. Undo steps of kept
+  // checks are remapped to their new indices.
+  void setContents(const QStringList &paths);
+
+  //---
+
+  // provider of lazy section children (not owned)
+  CQCheckTreeProvider *provider() const { return provider_; }
+  void setProvider(CQCheckTreeProvider *provider) { provider_ = provider; }
+
+  // add section whose children are added by the provider when first fetched.
+  // Until then its check state comes from the provider's aggregate counts.
+  int addLazySection(int parent, const QString &text);
+
+  // is section lazy and not yet fetched
+  bool isLazy(int node) const;
+
+  // provider child count and total checks of unfetched section (0 if not lazy)
+  int lazyChildCount(int node) const;
+  int lazyCheckCount(int node) const;
+
+  // add children of lazy section from provider
+  void fetchNode(int node);
+
+  bool isFetching() const { return fetchDepth_ > 0; }
+
+  //---
+
+  // bulk update (defer model notifications to a single reset at end)
+  void beginBulkUpdate();
+  void endBulkUpdate();
+
+  bool isBulkUpdate() const { return bulkDepth_ > 0; }
+
+  //---
+
+  // node data
+  int numNodes() const { return int(nodes_.size()); }
+
+  bool isValidNode(int node) const {
+    return (node >= 0 && node < int(nodes_.size()) && ! nodes_[size_t(node)].removed);
+  }
+
+  bool isSection(int node) const { return nodes_[size_t(node)].isSection; }
+
+  int parentNode(int node) const { return nodes_[size_t(node)].parent; }
+
+  // row in parent
+  int nodeRow(int node) const { return nodes_[size_t(node)].row; }
+
+  // index in parent's sections or checks
+  int nodeInd(int node) const { return nodes_[size_t(node)].ind; }
+
+  QString nodeText(int node) const;
+
+  // hierarchical name (section names are cached so check names only need
+  // their section prefix and label)
+  QString hierName(int node) const;
+
+  // append hierarchical name to string (no allocation if string has capacity,
+  // reuse a buffer with str.truncate(0))
+  void appendHierName(int node, QString &str) const;
+
+  // child sections and checks of section node
+  int numSections(int node) const;
+  int numChecks  (int node) const;
+
+  int sectionNode(int node, int i) const;
+  int checkNode  (int node, int i) const;
+
+  //---
+
+  // check state
+  bool isChecked(int node) const;
+
+  Qt::CheckState checkState(int node) const;
+
+  // number of checked checks in subtree (popcount of section check bits)
+  int countChecked(int node) const;
+
+  void setChecked(int node, bool checked);
+
+  // set checked state of several nodes as a single change
+  void setNodesChecked(const std::vector<int> &nodes, bool checked);
+
+  // group check changes into a single change set (nodesChecked signal and
+  // one dataChanged range per parent when outermost change ends)
+  void beginCheckChange();
+  void endCheckChange();
+
+  bool isCheckChange() const { return changeDepth_ > 0; }
+
+  //---
+
+  // undo/redo of check changes. Each change set (or single check change) is
+  // one step stored as runs of flipped check bits per section. Oldest steps
+  // are discarded when the journal exceeds the memory limit (0 disables).
+  // Steps which changed an unfetched lazy section are rewritten as check runs
+  // when the section is fetched so they stay undoable.
+  bool canUndo() const { return ! undoStack_.empty(); }
+  bool canRedo() const { return ! redoStack_.empty(); }
+
+  void undo();
+  void redo();
+
+  void clearUndo();
+
+  size_t undoMemoryLimit() const { return undoMemoryLimit_; }
+  void setUndoMemoryLimit(size_t bytes);
+
+  size_t undoMemory() const { return undoMemory_; }
+
+  //---
+
+  // tree index <-> node
+  int treeIndexNode(const CQCheckTreeIndex &ind) const;
+
+  // section node of index (root node for top level)
+  int sectionIndexNode(const CQCheckTreeIndex &ind) const;
+
+  CQCheckTreeIndex treeIndex(int node) const;
+
+  // number of levels below root (top level nodes have depth 1)
+  int nodeDepth(int node) const;
+
+  //---
+
+  Items getAllItems() const;
+  Items getCheckedItems() const;
+
+  // iterate all/checked items without building a list
+  CQCheckTreeItemRange items() const;
+  CQCheckTreeItemRange checkedItems() const;
+
+  // call f(item) for all/checked items until it returns false
+  // (returns false if stopped early)
+  template<typename F>
+  bool forEachItem(F f) const {
+    for (const auto &item : items())
+      if (! f(item)) return false;
+
+    return true;
+  }
+
+  template<typename F>
+  bool forEachChecked(F f) const {
+    for (const auto &item : checkedItems())
+      if (! f(item)) return false;
+
+    return true;
+  }
+
+  // next node after node in item order (-1 at end)
+  int nextItemNode(int node, bool checked) const;
+
+  //---
+
+  // save/restore check state in versioned binary format. Check bits are stored
+  // per section and restored directly if the structure fingerprint matches,
+  // otherwise checks are matched by section path and label. Restore is a
+  // single check change (returns false, without changing state, for an
+  // invalid, truncated or corrupt header or section data).
+  bool saveState(QIODevice &dev) const;
+  bool restoreState(QIODevice &dev);
+
+  // hash of node structure and labels
+  quint64 structureFingerprint() const;
+
+  //---
+
+  // structure snapshot (cached until structure changes, then only changed
+  // blocks of the previous snapshot are copied)
+  StructureSnapshotP structureSnapshot() const;
+
+  // published snapshot of structure and check state (can be called from any
+  // thread, null if snapshots are not enabled). A new snapshot is published at
+  // the end of each check change, bulk update or batch of node adds.
+  bool isSnapshotsEnabled() const { return snapshotsEnabled_; }
+  void setSnapshotsEnabled(bool b);
+
+  SnapshotP snapshot() const;
+
+  //---
+
+  // runtime counters (null when disabled, counting then only costs a branch)
+  bool isStatsEnabled() const { return bool(stats_); }
+  void setStatsEnabled(bool b);
+
+  CQCheckTreeStats *stats() const { return stats_.get(); }
+
+  void resetStats();
+
+  //---
+
+  // label search index (built when enabled then updated as nodes are added)
+  bool isSearchIndexed() const { return searchIndexed_; }
+  void setSearchIndexed(bool b);
+
+  // nodes whose label contains text (case insensitive) in increasing order.
+  // If text contains the hier separator the last part must be in the label and
+  // the rest in the parent's hierarchical name.
+  std::vector<int> findNodes(const QString &text) const;
+
+  // as above but only check nodes of previous (increasing) result
+  std::vector<int> findNodes(const QString &text, const std::vector<int> &nodes) const;
+
+  //---
+
+  // model index <-> node
+  QModelIndex nodeModelIndex(int node, int column=TEXT_COLUMN) const;
+
+  int modelIndexNode(const QModelIndex &index) const;
+
+  //---
+
+  // QAbstractItemModel
+  QModelIndex index(int row, int column, const QModelIndex &parent=QModelIndex()) const override;
+
+  QModelIndex parent(const QModelIndex &index) const override;
+
+  int rowCount(const QModelIndex &parent=QModelIndex()) const override;
+
+  int columnCount(const QModelIndex &parent=QModelIndex()) const override;
+
+  QVariant data(const QModelIndex &index, int role=Qt::DisplayRole) const override;
+
+  QVariant headerData(int section, Qt::Orientation orientation,
+                      int role=Qt::DisplayRole) const override;
+
+  Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+  bool hasChildren(const QModelIndex &parent=QModelIndex()) const override;
+
+  bool canFetchMore(const QModelIndex &parent) const override;
+
+  void fetchMore(const QModelIndex &parent) override;
+
+ Q_SIGNALS:
+  // single check changed outside of a check change
+  void nodeChecked(int node, bool checked);
+
+  // checks changed in a check change
+  void nodesChecked(const QVector<int> &nodes, bool checked);
+
+  // undo/redo availability changed
+  void undoChanged();
+
+ private Q_SLOTS:
+  void publishSnapshot();
+
+ private:
+  struct Node {
+    int  parent      { -1 }; // parent node
+    int  row         { -1 }; // row in parent
+    int  ind         { -1 }; // index in parent sections or checks
+    int  section     { -1 }; // section data (section nodes only)
+    uint labelOffset { 0 };  // offset of label in labels_
+    uint labelLength : 28;   // length of label
+    uint isSection   : 1;
+    uint changed     : 1;    // in pending change set
+    uint wasChecked  : 1;    // checked state before pending change set
+    uint removed     : 1;    // removed (id is free for reuse)
+
+    Node() : labelLength(0), isSection(0), changed(0), wasChecked(0), removed(0) { }
+  };
+
+  struct Section {
+    using Nodes = std::vector<int>;
+
+    Nodes           children;                 // child nodes in row order
+    Nodes           sections;                 // child section nodes
+    Nodes           checks;                   // child check nodes
+    CQCheckTreeBits checkBits;                // checked state of child checks
+    uint            numChecked         { 0 }; // checked child checks
+    uint            numSectionsChecked { 0 }; // fully checked child sections
+    uint            numSectionsPartial { 0 }; // partially checked child sections
+
+    // lazy (unfetched) section data
+    bool lazy         { false }; // children not fetched from provider
+    bool fetching     { false }; // children being fetched
+    int  lazyChildren { 0 };     // provider child count
+    uint lazyChecked  { 0 };     // checked checks in unfetched subtree
+    uint lazyTotal    { 0 };     // total checks in unfetched subtree
+    int  lazyOverride { -1 };    // checked state set before fetch (-1 if none)
+
+    // cached hierarchical name (valid if generation matches model's)
+    mutable QString hierName;
+    mutable uint    hierGen { 0 };
+
+    bool snapshotDirty { false }; // state changed since last published snapshot
+
+    // reset to new section state keeping child list and bit storage
+    void recycle() {
+      children .clear();
+      sections .clear();
+      checks   .clear();
+      checkBits.clear();
+
+      numChecked         = 0;
+      numSectionsChecked = 0;
+      numSectionsPartial = 0;
+
+      lazy         = false;
+      fetching     = false;
+      lazyChildren = 0;
+      lazyChecked  = 0;
+      lazyTotal    = 0;
+      lazyOverride = -1;
+
+      hierGen       = 0;
+      snapshotDirty = false;
+    }
+  };
+
+  using Nodes    = std::vector<Node>;
+  using Sections = std::vector<Section>;
+
+  using RowRange  = std::pair<int, int>;
+  using DirtyRows = std::map<int, RowRange>;
+
+  // undo step (applying it flips the bits and swaps the lazy states back)
+  struct UndoRun {
+    int section { -1 }; // section node
+    int start   { 0 };  // first check index
+    int length  { 0 };  // number of flipped checks
+  };
+
+  struct UndoLazy {
+    int  node          { -1 }; // lazy section node
+    int  lazyOverride  { -1 }; // state to apply
+    uint lazyChecked   { 0 };
+  };
+
+  struct UndoEntry {
+    std::vector<UndoRun>  runs;
+    std::vector<UndoLazy> lazy;
+
+    size_t memSize() const {
+      return sizeof(UndoEntry) + runs.capacity()*sizeof(UndoRun) +
+             lazy.capacity()*sizeof(UndoLazy);
+    }
+  };
+
+  using UndoStack = std::deque<UndoEntry>;
+  using CheckInds = std::vector<std::pair<int, int>>; // section node, check index
+
+  // check state of section in fetched subtree (journaled lazy states of a
+  // fetched section are rewritten from these)
+  struct SubtreeState {
+    int             node         { -1 };
+    CQCheckTreeBits bits;                // check bits (fetched section)
+    bool            lazy         { false };
+    int             lazyOverride { -1 };
+    uint            lazyChecked  { 0 };
+    uint            lazyTotal    { 0 };
+  };
+
+  using SubtreeStates = std::vector<SubtreeState>;
+
+ private:
+  void initRoot();
+
+  int allocSection();
+
+  // id for new node (reused removed id or next id) and set its data
+  int allocNode();
+  void setNode(int node, const Node &n);
+
+  // drop labels of removed nodes from label buffer
+  void compactLabels();
+
+  void removeChildren(int parent, int row, int count);
+  void removeSubtree(int node, std::vector<int> &removed);
+
+  // new child order of section node
+  using Reorder  = std::pair<int, std::vector<int>>;
+  using Reorders = std::vector<Reorder>;
+
+  void reorderChildren(const Reorders &reorders);
+  void updateChildLists(int parent);
+
+  struct ContentsSection;
+
+  using ContentsSections = std::vector<ContentsSection>;
+
+  bool reconcileSection(int node, const ContentsSections &sections, int ind,
+                        Reorders &reorders);
+
+  int addNode(int parent, const QString &text, bool isSection, bool isLazy=false);
+
+  const Section &nodeSection(int node) const;
+  Section &nodeSection(int node);
+
+  const QString &sectionHierName(int node) const;
+
+  void setCheckChecked(int node, bool checked);
+  void setSectionChecks(int node, bool checked);
+  void setLazyChecked(int node, bool checked);
+  void resetLazyChecked(int node);
+  void journalLazy(int node);
+  void setSectionBits(int node, const CQCheckTreeBits &bits);
+
+  QString sectionKey(int node) const;
+
+  bool matchNode(int node, const QString &label, const QString &path) const;
+
+  void addChangedNode(int node, bool wasChecked);
+
+  bool isJournaling() const;
+
+  void addUndoEntry(CheckInds &checkInds);
+  void pushUndo(UndoEntry &&entry);
+  void applyUndo(UndoEntry &entry);
+
+  // map journal check indices of section to new indices (-1 if removed) and
+  // drop journal changes of removed (sorted) nodes
+  void remapUndo(int node, const std::vector<int> &checkInds, const std::vector<int> &removed);
+
+  // is lazy state of section in undo or redo journal
+  bool isLazyJournaled(int node) const;
+
+  // states of section subtree sections in pre-order
+  void getSubtreeStates(int node, SubtreeStates &states) const;
+
+  // replace journaled lazy state of fetched section with flipped check runs
+  void rewriteLazyUndo(int node, const SubtreeStates &initStates);
+
+  void checkChanged(int section, bool checked);
+  void childStateChanged(int section, Qt::CheckState oldState, Qt::CheckState newState);
+  void updateState(int section, Qt::CheckState oldState);
+
+  void emitNodeChanged(int node);
+
+  void markStructureNode(int node);
+  void markStructureSection(int node);
+  void resetStructure();
+
+  StructureNode structureNode(int node) const;
+
+  void markSnapshotDirty(int node);
+  void schedulePublish();
+
+  void flushCheckChange();
+
+  int firstItemNode(bool checked) const;
+
+  int stepItemNode(int node, bool checked) const;
+  int nextSiblingItemNode(int node, bool checked) const;
+  int firstCheckNode(int node, int i, bool checked) const;
+
+  bool isIterItem(int node, bool checked) const;
+
+ private:
+  Nodes       nodes_;
+  Sections    sections_;
+  Sections    sectionPool_; // cleared sections (storage reused by new sections)
+  QString     labels_;
+  QStringList headers_;
+  QChar       hierSep_   { '/' };
+  uint        hierGen_   { 1 }; // cached hier name generation
+  int         bulkDepth_ { 0 };
+
+  // removed node ids and section indices (reused by adds) and label characters
+  // of removed nodes (label buffer is compacted when mostly removed labels)
+  std::vector<int> freeNodes_;
+  std::vector<int> freeSections_;
+  int              removedChars_ { 0 };
+
+  // structure snapshot and its copy updated from changed nodes and sections
+  mutable StructureSnapshotP structureSnapshot_;
+  mutable StructureSnapshot  structureCopy_;
+  mutable std::vector<int>   structureNodesDirty_;    // changed nodes
+  mutable std::vector<int>   structureSectionsDirty_; // changed section indices
+
+  // published snapshot (only accessed with atomic load/store)
+  bool             snapshotsEnabled_ { false };
+  SnapshotP        snapshot_;
+  std::vector<int> snapshotDirty_;            // dirty section indices
+  bool             snapshotReset_   { true }; // all sections dirty
+  bool             publishPending_  { false };
+  uint             snapshotSerial_  { 0 };
+
+  // section path -> section node (built on first path add)
+  QHash<QString, int> pathSections_;
+  bool                pathSectionsValid_ { false };
+
+  // runtime counters (null when disabled)
+  std::unique_ptr<CQCheckTreeStats> stats_;
+
+  // label search
+  bool                   searchIndexed_ { false };
+  CQCheckTreeSearchIndex searchIndex_;
+
+  // lazy section provider
+  CQCheckTreeProvider *provider_   { nullptr };
+  int                  fetchDepth_ { 0 };
+
+  // pending check change set
+  int              changeDepth_ { 0 };
+  std::vector<int> changedNodes_;
+  DirtyRows        dirtyRows_; // changed row range per parent node
+
+  // undo journal
+  UndoStack             undoStack_;
+  UndoStack             redoStack_;
+  std::vector<UndoLazy> undoLazy_;                           // pending lazy states
+  size_t                undoMemory_      { 0 };
+  size_t                undoMemoryLimit_ { 8*1024*1024 };
+  int                   replayDepth_     { 0 };
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef CQCheckTreeProvider_H
+#define CQCheckTreeProvider_H
+
+class CQCheckTreeModel;
+
+// provider of section children which are only added to the model when the
+// section is first expanded (see CQCheckTreeModel::addLazySection)
+class CQCheckTreeProvider {
+ public:
+  CQCheckTreeProvider() { }
+
+  virtual ~CQCheckTreeProvider() { }
+
+  // number of children of unfetched section node
+  virtual int childCount(const CQCheckTreeModel *model, int node) const = 0;
+
+  // number of checked checks and total checks in unfetched subtree of section node
+  virtual void checkCounts(const CQCheckTreeModel *model, int node,
+                           int &numChecked, int &numChecks) const = 0;
+
+  // add children of section node to model (addSection, addLazySection, addCheck
+  // and setChecked can be used to build the children and their initial state)
+  virtual void fetchChildren(CQCheckTreeModel *model, int node) = 0;
+};
+
+#endif
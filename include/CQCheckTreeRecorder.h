@@ -0,0 +1,123 @@
+#ifndef CQCheckTreeRecorder_H
+#define CQCheckTreeRecorder_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <QSize>
+#include <set>
+#include <vector>
+
+class CQCheckTree;
+class QIODevice;
+class QModelIndex;
+
+// recorded user session on a check tree.
+//
+// The trace starts with the tree structure, check state and size when
+// recording started followed by the interaction events (nodes are trace node
+// numbers, i.e. model node numbers of the replayed structure, -1 for a node
+// not in the trace). Stored in a versioned binary format.
+struct CQCheckTreeTrace {
+  enum class EventType {
+    CLICK    = 0, // click on node column
+    EXPAND   = 1, // expand section node
+    COLLAPSE = 2, // collapse section node
+    ACTION   = 3, // context menu action (tree slot name)
+    RESIZE   = 4  // tree resized
+  };
+
+  struct Node {
+    int     parent    { -1 };
+    bool    isSection { false };
+    QString label;
+
+    // unfetched lazy section (replayed with provider returning these counts)
+    bool isLazy      { false };
+    int  numChildren { 0 };
+    int  numChecked  { 0 };
+    int  numChecks   { 0 };
+  };
+
+  struct Event {
+    EventType type   { EventType::CLICK };
+    quint32   dt     { 0 };  // msecs since previous event
+    int       node   { -1 };
+    int       column { 0 };
+    QString   name;          // action name
+    QSize     size;          // resize size
+  };
+
+  std::vector<Node>  nodes; // nodes after root in pre-order (children in row order)
+  QByteArray         state; // saved check state
+  QSize              size;  // initial tree size
+  std::vector<Event> events;
+
+  bool write(QIODevice &dev) const;
+  bool read(QIODevice &dev);
+
+  // rebuild recorded structure and state in tree (replaces contents). If there
+  // are lazy sections the tree's provider is set to a stub provider (owned by
+  // tree) which fetches the recorded number of placeholder checks.
+  void restore(CQCheckTree *tree) const;
+};
+
+//---
+
+// records interaction with check tree (clicks, expand/collapse, context menu
+// actions and resizes) into a trace for offscreen replay. The tree structure
+// must not change while recording except for fetches of lazy sections, whose
+// children get the trace numbers of the checks replay fetches for them.
+class CQCheckTreeRecorder : public QObject {
+  Q_OBJECT
+
+ public:
+  CQCheckTreeRecorder(CQCheckTree *tree);
+ ~CQCheckTreeRecorder();
+
+  bool isRecording() const { return recording_; }
+
+  // start recording (captures current structure and state)
+  void start();
+
+  // stop recording
+  void stop();
+
+  const CQCheckTreeTrace &trace() const { return trace_; }
+
+  // number of recorded node events on nodes not in the trace (recorded with
+  // node -1 and skipped by replay)
+  int numUnmappedEvents() const { return numUnmapped_; }
+
+  bool eventFilter(QObject *obj, QEvent *e) override;
+
+ private:
+  void addEvent(CQCheckTreeTrace::Event &event);
+
+  int traceNode(const QModelIndex &index);
+
+  void mapFetched();
+
+ private Q_SLOTS:
+  void clickedSlot(const QModelIndex &index);
+  void expandedSlot(const QModelIndex &index);
+  void collapsedSlot(const QModelIndex &index);
+  void actionSlot(const QString &name);
+
+  void rowsInsertedSlot(const QModelIndex &parent, int first, int last);
+
+ private:
+  CQCheckTree*     tree_      { nullptr };
+  bool             recording_ { false };
+  CQCheckTreeTrace trace_;
+  std::vector<int> nodeMap_;          // model node -> trace node
+  int              numTraceNodes_ { 0 };
+  std::vector<int> pendingFetch_;     // fetched lazy sections to number children of
+  std::set<int>    fetched_;          // fetched lazy trace nodes
+  int              numUnmapped_   { 0 };
+  QElapsedTimer    timer_;
+  qint64           lastTime_  { 0 };
+};
+
+#endif
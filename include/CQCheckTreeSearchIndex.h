@@ -0,0 +1,51 @@
+#ifndef CQCheckTreeSearchIndex_H
+#define CQCheckTreeSearchIndex_H
+
+#include <QHash>
+#include <QString>
+#include <vector>
+
+// trigram index of lower case node labels.
+//
+// Each trigram maps to the increasing list of nodes whose label contains it so
+// the candidates for a query are the intersection of its trigram lists (nodes
+// added out of order, i.e. reused node ids, are inserted in order).
+class CQCheckTreeSearchIndex {
+ public:
+  using Nodes = std::vector<int>;
+
+  enum { MIN_QUERY_LENGTH = 3 };
+
+ public:
+  CQCheckTreeSearchIndex() { }
+
+  void clear();
+
+  void addLabel(int node, const QChar *label, int len);
+
+  // queue removal of node with label (applied by flushRemoved so each posting
+  // list is filtered once for all removed nodes)
+  void removeLabel(int node, const QChar *label, int len);
+
+  void flushRemoved();
+
+  // candidate nodes for lower case text of at least MIN_QUERY_LENGTH chars
+  // (superset of nodes containing text)
+  void candidates(const QString &text, Nodes &nodes) const;
+
+ private:
+  using Trigram  = quint64;
+  using Postings = QHash<Trigram, Nodes>;
+  using Trigrams = std::vector<Trigram>;
+
+  static Trigram trigram(QChar c1, QChar c2, QChar c3) {
+    return (Trigram(c1.unicode()) << 32) | (Trigram(c2.unicode()) << 16) | Trigram(c3.unicode());
+  }
+
+ private:
+  Postings postings_;
+  Nodes    removedNodes_;    // queued removed nodes
+  Trigrams removedTrigrams_; // trigrams of queued removed nodes
+};
+
+#endif
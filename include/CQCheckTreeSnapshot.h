@@ -0,0 +1,81 @@
+#ifndef CQCheckTreeSnapshot_H
+#define CQCheckTreeSnapshot_H
+
+#include <CQCheckTreeModel.h>
+
+// immutable view of model structure and check state (safe to read from any
+// thread).
+//
+// Snapshots are published by the model after each check change set and
+// share the structure and the state of unchanged sections with the previous
+// snapshot, so holding an old snapshot only keeps the changed sections alive.
+// States are stored in blocks so a publish only copies the blocks of changed
+// sections.
+class CQCheckTreeSnapshot {
+ public:
+  using StructureSnapshotP = CQCheckTreeModel::StructureSnapshotP;
+
+  // check bits and aggregate state of section
+  struct SectionState {
+    CQCheckTreeBits checkBits;
+    Qt::CheckState  state { Qt::Unchecked };
+  };
+
+  using SectionStateP = std::shared_ptr<const SectionState>;
+  using SectionStates = CQCheckTreeChunks<SectionStateP>;
+
+ public:
+  CQCheckTreeSnapshot(const StructureSnapshotP &structure, const SectionStates &states,
+                      const QChar &hierSep, uint serial);
+
+  // publish count of model when snapshot was taken
+  uint serial() const { return serial_; }
+
+  const StructureSnapshotP &structure() const { return structure_; }
+
+  const SectionStates &sectionStates() const { return states_; }
+
+  const SectionStateP &sectionState(int section) const { return states_[size_t(section)]; }
+
+  //---
+
+  // node data
+  int numNodes() const { return int(structure_->nodes.size()); }
+
+  bool isValidNode(int node) const {
+    return (node >= 0 && node < numNodes() && ! structureNode(node).removed);
+  }
+
+  bool isSection(int node) const { return structureNode(node).section >= 0; }
+
+  int parentNode(int node) const { return structureNode(node).parent; }
+
+  QString nodeText(int node) const;
+
+  QString hierName(int node) const;
+
+  //---
+
+  // check state
+  bool isChecked(int node) const;
+
+  Qt::CheckState checkState(int node) const;
+
+  // tree index -> node (-1 if invalid)
+  int treeIndexNode(const CQCheckTreeIndex &ind) const;
+
+  bool isChecked(const CQCheckTreeIndex &ind) const;
+
+ private:
+  const CQCheckTreeModel::StructureNode &structureNode(int node) const {
+    return structure_->nodes[size_t(node)];
+  }
+
+ private:
+  StructureSnapshotP structure_;
+  SectionStates      states_;
+  QChar              hierSep_;
+  uint               serial_ { 0 };
+};
+
+#endif
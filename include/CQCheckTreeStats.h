@@ -0,0 +1,62 @@
+#ifndef CQCheckTreeStats_H
+#define CQCheckTreeStats_H
+
+#include <QtGlobal>
+#include <chrono>
+
+// runtime counters of check tree work (see CQCheckTreeModel::setStatsEnabled).
+//
+// Each counter has the number of calls and the total time spent in them
+// (nested calls are included in the time of their caller, e.g. updateState
+// includes its checkState calls).
+struct CQCheckTreeStats {
+  struct Counter {
+    qint64 count { 0 };
+    qint64 nsecs { 0 };
+
+    double msecs() const { return double(nsecs)/1e6; }
+  };
+
+  Counter checkState;  // model check state evaluations
+  Counter updateState; // section state propagation steps (ancestor walk)
+  Counter dataChanged; // model dataChanged emissions
+  Counter itemChecked; // itemChecked/itemsChecked emissions
+  Counter paint;       // delegate paint calls
+  Counter fitColumns;  // column fits
+
+  void reset() { *this = CQCheckTreeStats(); }
+};
+
+//---
+
+// adds call count and elapsed time to counter on scope exit (no-op for null
+// counter so disabled stats only cost a branch)
+class CQCheckTreeStatsTimer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+ public:
+  CQCheckTreeStatsTimer(CQCheckTreeStats::Counter *counter) :
+   counter_(counter) {
+    if (counter_)
+      start_ = Clock::now();
+  }
+
+ ~CQCheckTreeStatsTimer() {
+    if (counter_) {
+      ++counter_->count;
+
+      counter_->nsecs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           Clock::now() - start_).count();
+    }
+  }
+
+  CQCheckTreeStatsTimer(const CQCheckTreeStatsTimer &) = delete;
+  CQCheckTreeStatsTimer &operator=(const CQCheckTreeStatsTimer &) = delete;
+
+ private:
+  CQCheckTreeStats::Counter* counter_ { nullptr };
+  Clock::time_point          start_;
+};
+
+#endif
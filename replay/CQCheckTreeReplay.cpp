@@ -0,0 +1,179 @@
+#include <CQCheckTree.h>
+#include <CQCheckTreeRecorder.h>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+// replay recorded check tree session (see CQCheckTreeRecorder) and report
+// per event latency percentiles.
+//
+// Usage: CQCheckTreeReplay <trace> [repeat]
+//
+// Events are replayed back to back (recorded delays are ignored). Each event's
+// latency includes processing posted events and a synchronous repaint of the
+// tree viewport. Events on nodes not in the replayed tree (node -1 in trace)
+// are skipped and reported as an error. QT_QPA_PLATFORM defaults to offscreen.
+
+namespace {
+
+using EventType = CQCheckTreeTrace::EventType;
+using Latencies = std::vector<qint64>; // nsecs
+
+const char *eventTypeName(EventType type)
+{
+  switch (type) {
+    case EventType::CLICK   : return "click";
+    case EventType::EXPAND  : return "expand";
+    case EventType::COLLAPSE: return "collapse";
+    case EventType::ACTION  : return "action";
+    case EventType::RESIZE  : return "resize";
+    default                 : return "?";
+  }
+}
+
+// replay event (returns false if event's node is not in replayed tree)
+bool
+replayEvent(CQCheckTree *tree, const CQCheckTreeTrace::Event &event)
+{
+  auto *model = tree->model();
+
+  bool validNode = (event.node > CQCheckTreeModel::ROOT_NODE && model->isValidNode(event.node));
+
+  switch (event.type) {
+    case EventType::CLICK:
+      // routed through tree's click handler as for a real click
+      if (! validNode)
+        return false;
+
+      QMetaObject::invokeMethod(tree, "itemClicked",
+        Q_ARG(QModelIndex, model->nodeModelIndex(event.node, event.column)));
+      break;
+    case EventType::EXPAND:
+      if (! validNode)
+        return false;
+
+      tree->tree()->expand(model->nodeModelIndex(event.node));
+      break;
+    case EventType::COLLAPSE:
+      if (! validNode)
+        return false;
+
+      tree->tree()->collapse(model->nodeModelIndex(event.node));
+      break;
+    case EventType::ACTION:
+      QMetaObject::invokeMethod(tree, event.name.toLatin1().constData());
+      break;
+    case EventType::RESIZE:
+      tree->resize(event.size);
+      break;
+  }
+
+  return true;
+}
+
+void
+printLatencies(const char *name, Latencies &latencies)
+{
+  if (latencies.empty())
+    return;
+
+  std::sort(latencies.begin(), latencies.end());
+
+  auto percentile = [&](double p) {
+    size_t i = size_t(p*double(latencies.size() - 1) + 0.5);
+
+    return double(latencies[i])/1e6;
+  };
+
+  printf("%-10s %8zu %10.3f %10.3f %10.3f %10.3f\n", name, latencies.size(),
+         percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+
+  QApplication app(argc, argv);
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: CQCheckTreeReplay <trace> [repeat]\n");
+    return 1;
+  }
+
+  QFile file(argv[1]);
+
+  CQCheckTreeTrace trace;
+
+  if (! file.open(QIODevice::ReadOnly) || ! trace.read(file)) {
+    fprintf(stderr, "Invalid trace file '%s'\n", argv[1]);
+    return 1;
+  }
+
+  int repeat = (argc > 2 ? std::max(atoi(argv[2]), 1) : 1);
+
+  //---
+
+  auto *tree = new CQCheckTree;
+
+  tree->show();
+
+  std::map<EventType, Latencies> typeLatencies;
+
+  Latencies allLatencies;
+
+  int numSkipped = 0;
+
+  for (int i = 0; i < repeat; ++i) {
+    trace.restore(tree);
+
+    app.processEvents();
+
+    for (const auto &event : trace.events) {
+      QElapsedTimer timer;
+
+      timer.start();
+
+      if (! replayEvent(tree, event)) {
+        ++numSkipped;
+        continue;
+      }
+
+      app.processEvents();
+
+      tree->tree()->viewport()->repaint();
+
+      qint64 t = timer.nsecsElapsed();
+
+      typeLatencies[event.type].push_back(t);
+
+      allLatencies.push_back(t);
+    }
+  }
+
+  //---
+
+  printf("%-10s %8s %10s %10s %10s %10s\n", "event", "count", "p50 ms", "p90 ms",
+         "p99 ms", "max ms");
+
+  for (auto &pt : typeLatencies)
+    printLatencies(eventTypeName(pt.first), pt.second);
+
+  printLatencies("all", allLatencies);
+
+  // node not recorded (or not fetched) so replay differs from session
+  if (numSkipped > 0)
+    fprintf(stderr, "Error: %d events on nodes not in replayed tree skipped\n", numSkipped);
+
+  delete tree;
+
+  return (numSkipped > 0 ? 2 : 0);
+}
@@ -0,0 +1,25 @@
+TEMPLATE = app
+
+TARGET = CQCheckTreeReplay
+
+DEPENDPATH += .
+
+QT += widgets
+
+CONFIG += release
+
+# Input
+SOURCES += \
+CQCheckTreeReplay.cpp \
+
+DESTDIR     = .
+OBJECTS_DIR = .
+
+INCLUDEPATH += \
+../include \
+.
+
+unix:LIBS += \
+-L../lib \
+-lCQCheckTree \
+-lCQCheckTreeCore
@@ -1,4 +1,5 @@
 #include <CQCheckTree.h>
+#include <CQCheckTreeFuzzyMatcher.h>
 
 #include <QHeaderView>
 #include <QVBoxLayout>
@@ -6,9 +7,14 @@
 #include <QPainter>
 #include <QMouseEvent>
 #include <QMenu>
+#include <QLineEdit>
+#include <QPixmap>
+#include <QAccessible>
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <iterator>
 
 class CQCheckTreeDelegate : public QItemDelegate {
  public:
@@ -19,8 +25,31 @@ class CQCheckTreeDelegate : public QItemDelegate {
 
   QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
 
+  // discard cached check glyphs (style, font or screen changed)
+  void invalidateGlyphs();
+
+ private:
+  const QPixmap &checkGlyph(QPainter *painter, const QStyleOptionViewItem &option,
+                            Qt::CheckState checkState) const;
+
  private:
-  CQCheckTree *tree_ { nullptr };
+  // check glyphs are rendered once per size, device pixel ratio, palette and
+  // enabled state and blitted for each row
+  struct GlyphKey {
+    int    checkSize { -1 };
+    qreal  dpr       { 0.0 };
+    qint64 palette   { 0 };
+    bool   enabled   { false };
+
+    friend bool operator==(const GlyphKey &lhs, const GlyphKey &rhs) {
+      return (lhs.checkSize == rhs.checkSize && lhs.dpr == rhs.dpr &&
+              lhs.palette == rhs.palette && lhs.enabled == rhs.enabled);
+    }
+  };
+
+  CQCheckTree     *tree_ { nullptr };
+  mutable GlyphKey glyphKey_;
+  mutable QPixmap  glyphs_[3]; // indexed by Qt::CheckState
 };
 
 //------
@@ -34,6 +63,24 @@ CQCheckTree(QWidget *parent) :
   auto *layout = new QVBoxLayout(this);
   layout->setMargin(0); layout->setSpacing(0);
 
+  model_ = new CQCheckTreeModel(this);
+
+  connect(model_, SIGNAL(nodeChecked(int, bool)),
+          this, SLOT(nodeCheckedSlot(int, bool)));
+  connect(model_, SIGNAL(nodesChecked(const QVector<int> &, bool)),
+          this, SLOT(nodesCheckedSlot(const QVector<int> &, bool)));
+
+  filterEdit_ = new QLineEdit;
+
+  filterEdit_->setObjectName("filter");
+  filterEdit_->setPlaceholderText("Filter");
+  filterEdit_->setVisible(false);
+
+  connect(filterEdit_, SIGNAL(textChanged(const QString &)),
+          this, SLOT(setFilter(const QString &)));
+
+  layout->addWidget(filterEdit_);
+
   tree_ = new CQCheckTreeWidget(this);
 
   layout->addWidget(tree_);
@@ -41,6 +88,20 @@ CQCheckTree(QWidget *parent) :
   connect(tree_, SIGNAL(clicked(const QModelIndex &)),
           this, SLOT(itemClicked(const QModelIndex &)));
 
+  // track column widths
+  connect(model_, SIGNAL(rowsInserted(const QModelIndex &, int, int)),
+          this, SLOT(rowsInsertedSlot(const QModelIndex &, int, int)));
+  connect(model_, SIGNAL(rowsAboutToBeRemoved(const QModelIndex &, int, int)),
+          this, SLOT(rowsAboutToBeRemovedSlot(const QModelIndex &, int, int)));
+  connect(model_, SIGNAL(rowsRemoved(const QModelIndex &, int, int)),
+          this, SLOT(rowsRemovedSlot()));
+  connect(model_, SIGNAL(modelReset()), this, SLOT(modelResetSlot()));
+
+  connect(tree_, SIGNAL(expanded(const QModelIndex &)),
+          this, SLOT(expandedSlot(const QModelIndex &)));
+  connect(tree_, SIGNAL(collapsed(const QModelIndex &)),
+          this, SLOT(collapsedSlot(const QModelIndex &)));
+
   //---
 
   // add menu
@@ -72,10 +133,7 @@ void
 CQCheckTree::
 clear()
 {
-  tree_->clear();
-
-  sections_.clear();
-  checks_  .clear();
+  model_->clear();
 
   needsFit_ = true;
 }
@@ -84,211 +142,283 @@ CQCheckTreeIndex
 CQCheckTree::
 addSection(const QString &section)
 {
-  auto *sectionItem = new CQCheckTreeSection(this, section);
-
-  tree_->addTopLevelItem(sectionItem);
+  int node = model_->addSection(CQCheckTreeModel::ROOT_NODE, section);
 
-  sections_.push_back(sectionItem);
+  needsFit_ = true;
 
-  int n = int(sections_.size() - 1);
+  return CQCheckTreeIndex(model_->nodeInd(node), -1, -1);
+}
 
-  sectionItem->setInd(n);
+CQCheckTreeIndex
+CQCheckTree::
+addSection(const CQCheckTreeIndex &ind, const QString &section)
+{
+  // add child section of section at any depth
+  assert(ind.itemInd == -1);
 
-  auto index = CQCheckTreeIndex(n, -1, -1);
+  int sectionNode = model_->sectionIndexNode(ind);
+  assert(sectionNode >= 0);
 
-  sectionItem->setIndex(index);
+  int node = model_->addSection(sectionNode, section);
 
   needsFit_ = true;
 
-  return index;
+  return ind.childSectionIndex(model_->nodeInd(node));
 }
 
 CQCheckTreeIndex
 CQCheckTree::
-addSection(const CQCheckTreeIndex &ind, const QString &section)
+addSection(int sectionInd, const QString &section)
 {
-  assert(ind.itemInd == -1);
-  assert(ind.subSectionInd == -1);
+  int sectionNode = model_->sectionNode(CQCheckTreeModel::ROOT_NODE, sectionInd);
+  assert(sectionNode >= 0);
+
+  int node = model_->addSection(sectionNode, section);
+
+  needsFit_ = true;
 
-  return addSection(ind.sectionInd, section);
+  return CQCheckTreeIndex(sectionInd, model_->nodeInd(node), -1);
 }
 
 CQCheckTreeIndex
 CQCheckTree::
-addSection(int sectionInd, const QString &section)
+addCheck(const QString &name)
 {
-  assert(sectionInd >= 0 && sectionInd < int(sections_.size()));
+  // add toplevel item
+  int node = model_->addCheck(CQCheckTreeModel::ROOT_NODE, name);
 
-  auto *sectionItem = sections_[size_t(sectionInd)];
+  needsFit_ = true;
+
+  return CQCheckTreeIndex(model_->nodeInd(node)); // root
+}
 
-  auto n = sectionItem->addSection(section);
+CQCheckTreeIndex
+CQCheckTree::
+addCheck(const CQCheckTreeIndex &ind, const QString &name)
+{
+  // add check to section at any depth
+  assert(ind.itemInd == -1);
 
-  auto index = CQCheckTreeIndex(sectionInd, n, -1);
+  int sectionNode = model_->sectionIndexNode(ind);
+  assert(sectionNode >= 0);
 
-  sectionItem->setIndex(index);
+  int node = model_->addCheck(sectionNode, name);
 
   needsFit_ = true;
 
-  return index;
+  auto ind1 = ind;
+
+  ind1.itemInd = model_->nodeInd(node);
+
+  return ind1;
 }
 
 CQCheckTreeIndex
 CQCheckTree::
-addCheck(const QString &name)
+addCheck(int sectionInd, const QString &name)
 {
-  // add toplevel item
-  auto *checkItem = new CQCheckTreeCheck(this, nullptr, name);
+  // add section item
+  int sectionNode = model_->sectionNode(CQCheckTreeModel::ROOT_NODE, sectionInd);
+  assert(sectionNode >= 0);
 
-  tree_->addTopLevelItem(checkItem);
+  int node = model_->addCheck(sectionNode, name);
 
-  checks_.push_back(checkItem);
+  needsFit_ = true;
 
-  int n = int(checks_.size() - 1);
+  return CQCheckTreeIndex(sectionInd, model_->nodeInd(node)); // section
+}
 
-  checkItem->setInd(n);
+CQCheckTreeIndex
+CQCheckTree::
+addCheck(int sectionInd, int subSectionInd, const QString &name)
+{
+  // add sub section item
+  int sectionNode = model_->sectionNode(CQCheckTreeModel::ROOT_NODE, sectionInd);
+  assert(sectionNode >= 0);
 
-  auto index = CQCheckTreeIndex(checkItem->ind()); // root
+  int subSectionNode = model_->sectionNode(sectionNode, subSectionInd);
+  assert(subSectionNode >= 0);
 
-  checkItem->setIndex(index);
+  int node = model_->addCheck(subSectionNode, name);
 
   needsFit_ = true;
 
-  return index;
+  return CQCheckTreeIndex(sectionInd, subSectionInd, model_->nodeInd(node));
 }
 
 CQCheckTreeIndex
 CQCheckTree::
-addCheck(const CQCheckTreeIndex &ind, const QString &name)
+addChecks(const CQCheckTreeIndex &ind, const QStringList &names)
 {
   assert(ind.itemInd == -1);
 
-  if (ind.subSectionInd != -1)
-    return addCheck(ind.sectionInd, ind.subSectionInd, name);
-  else
-    return addCheck(ind.sectionInd, name);
+  int sectionNode = model_->sectionIndexNode(ind);
+  assert(sectionNode >= 0);
+
+  int node = model_->addChecks(sectionNode, names);
+
+  needsFit_ = true;
+
+  if (node < 0)
+    return CQCheckTreeIndex();
+
+  return model_->treeIndex(node);
 }
 
 CQCheckTreeIndex
 CQCheckTree::
-addCheck(int sectionInd, const QString &name)
+addCheckPath(const QString &path)
 {
-  assert(sectionInd >= 0 && sectionInd < int(sections_.size()));
+  int node = model_->addCheckPath(path);
 
-  // add section item
-  auto *sectionItem = sections_[size_t(sectionInd)];
+  needsFit_ = true;
 
-  auto *checkItem = new CQCheckTreeCheck(this, sectionItem, name);
+  return model_->treeIndex(node);
+}
 
-  int itemInd = sectionItem->addCheck(checkItem);
+void
+CQCheckTree::
+addCheckPaths(const QStringList &paths)
+{
+  model_->addCheckPaths(paths);
 
-  checkItem->setInd(itemInd);
+  needsFit_ = true;
 
-  auto index = CQCheckTreeIndex(sectionInd, itemInd); // section
+  update();
+}
 
-  checkItem->setIndex(index);
+void
+CQCheckTree::
+setContents(const QStringList &paths)
+{
+  model_->setContents(paths);
 
   needsFit_ = true;
 
-  return index;
+  update();
 }
 
 CQCheckTreeIndex
 CQCheckTree::
-addCheck(int sectionInd, int subSectionInd, const QString &name)
+addLazySection(const CQCheckTreeIndex &ind, const QString &section)
 {
-  // add toplevel item
-  assert(sectionInd >= 0 && sectionInd < int(sections_.size()));
+  assert(ind.itemInd == -1);
 
-  // add section item
-  auto *sectionItem = sections_[size_t(sectionInd)];
+  int sectionNode = model_->sectionIndexNode(ind);
+  assert(sectionNode >= 0);
 
-  auto *checkItem = sectionItem->addCheck(subSectionInd, name);
+  int node = model_->addLazySection(sectionNode, section);
 
-  auto index = CQCheckTreeIndex(sectionInd, subSectionInd, checkItem->ind());
+  needsFit_ = true;
 
-  checkItem->setIndex(index);
+  return ind.childSectionIndex(model_->nodeInd(node));
+}
 
-  needsFit_ = true;
+bool
+CQCheckTree::
+removeCheck(const CQCheckTreeIndex &ind)
+{
+  int node = model_->treeIndexNode(ind);
+
+  if (node < 0 || model_->isSection(node))
+    return false;
 
-  return index;
+  return model_->removeCheck(node);
 }
 
 bool
 CQCheckTree::
-isItemChecked(const CQCheckTreeIndex &ind) const
+removeSection(const CQCheckTreeIndex &ind)
 {
-  int sectionInd    = ind.sectionInd;
-  int subSectionInd = ind.subSectionInd;
-  int checkInd      = ind.itemInd;
+  if (ind.itemInd != -1 || ind.sectionInd < 0)
+    return false;
 
-  // top level check
-  if (sectionInd < 0 || sectionInd >= int(sections_.size())) {
-    CQCheckTreeCheck *checkItem = nullptr;
+  int node = model_->treeIndexNode(ind);
 
-    if (checkInd >= 0 && checkInd < int(checks_.size()))
-      checkItem = checks_[size_t(checkInd)];
+  if (node < 0)
+    return false;
 
-    return (checkItem ? checkItem->isChecked() : false);
-  }
+  return model_->removeSection(node);
+}
 
-  // section check
-  auto *sectionItem = sections_[size_t(sectionInd)];
+bool
+CQCheckTree::
+removeRange(const CQCheckTreeIndex &ind, int row, int count)
+{
+  assert(ind.itemInd == -1);
 
-  if (checkInd < 0)
-    return (sectionItem->checkState() == Qt::Checked);
+  int sectionNode = model_->sectionIndexNode(ind);
 
-  if (subSectionInd >= 0)
-    return sectionItem->isItemChecked(subSectionInd, checkInd);
-  else
-    return sectionItem->isItemChecked(checkInd);
+  if (sectionNode < 0)
+    return false;
+
+  return model_->removeRange(sectionNode, row, count);
+}
+
+void
+CQCheckTree::
+beginBulkUpdate()
+{
+  model_->beginBulkUpdate();
+}
+
+void
+CQCheckTree::
+endBulkUpdate()
+{
+  model_->endBulkUpdate();
+
+  if (! model_->isBulkUpdate()) {
+    needsFit_ = true;
+
+    update();
+  }
+}
+
+bool
+CQCheckTree::
+isItemChecked(const CQCheckTreeIndex &ind) const
+{
+  int node = model_->treeIndexNode(ind);
+
+  return model_->isChecked(node);
 }
 
 void
 CQCheckTree::
 setItemChecked(const CQCheckTreeIndex &ind, bool checked)
 {
-  int sectionInd    = ind.sectionInd;
-  int subSectionInd = ind.subSectionInd;
-  int checkInd      = ind.itemInd;
+  int node = model_->treeIndexNode(ind);
 
-  // top level check
-  if (sectionInd < 0 || sectionInd >= int(sections_.size())) {
-    CQCheckTreeCheck *checkItem = nullptr;
+  model_->setChecked(node, checked);
+}
 
-    if (checkInd >= 0 && checkInd < int(checks_.size()))
-      checkItem = checks_[size_t(checkInd)];
+void
+CQCheckTree::
+setItemsChecked(const std::vector<CQCheckTreeIndex> &inds, bool checked)
+{
+  std::vector<int> nodes;
 
-    if (checkItem)
-      checkItem->setChecked(checked);
+  nodes.reserve(inds.size());
 
-    return;
-  }
+  for (const auto &ind : inds) {
+    int node = model_->treeIndexNode(ind);
 
-  // section check
-  auto *sectionItem = sections_[size_t(sectionInd)];
+    if (node >= 0)
+      nodes.push_back(node);
+  }
 
-  if (subSectionInd >= 0)
-    sectionItem->setItemChecked(subSectionInd, checkInd, checked);
-  else
-    sectionItem->setItemChecked(checkInd, checked);
+  model_->setNodesChecked(nodes, checked);
 }
 
 bool
 CQCheckTree::
 hasSection(const CQCheckTreeIndex &ind) const
 {
-  int sectionInd    = ind.sectionInd;
-  int subSectionInd = ind.subSectionInd;
-
-  if (sectionInd < 0 || sectionInd >= int(sections_.size()))
+  if (ind.sectionInd < 0)
     return false;
 
-  if (subSectionInd < 0)
-    return true;
-
-  auto *sectionItem = sections_[size_t(sectionInd)];
-
-  return sectionItem->hasSection(subSectionInd);
+  return (model_->sectionIndexNode(ind) >= 0);
 }
 
 QString
@@ -303,154 +433,138 @@ getSectionText(const CQCheckTreeIndex &ind) const
   if (ind.subSectionInd >= 0) {
     assert(ind.sectionInd >= 0);
 
-    auto *sectionItem = sections_[size_t(ind.sectionInd)];
+    subSectionName = getSectionText(ind.sectionInd, ind.subSectionInd);
+  }
+
+  auto text = QString("%1:%2").arg(sectionName).arg(subSectionName);
 
-    subSectionName = sectionItem->getSectionText(ind.subSectionInd);
+  // deeper sections
+  int depth = ind.depth();
+
+  if (depth > 2) {
+    int sectionNode = model_->sectionIndexNode(ind);
+    assert(sectionNode >= 0);
+
+    QStringList names;
+
+    for (int level = depth - 1; level >= 2; --level) {
+      names.prepend(model_->nodeText(sectionNode));
+
+      sectionNode = model_->parentNode(sectionNode);
+    }
+
+    text += ":" + names.join(":");
   }
 
-  return QString("%1:%2").arg(sectionName).arg(subSectionName);
+  return text;
 }
 
 QString
 CQCheckTree::
 getSectionText(int sectionInd) const
 {
-  assert(sectionInd >= 0 && sectionInd < int(sections_.size()));
+  int sectionNode = model_->sectionNode(CQCheckTreeModel::ROOT_NODE, sectionInd);
+  assert(sectionNode >= 0);
 
-  auto *sectionItem = sections_[size_t(sectionInd)];
-
-  return sectionItem->text();
+  return model_->nodeText(sectionNode);
 }
 
 QString
 CQCheckTree::
 getSectionText(int sectionInd, int subSectionInd) const
 {
-  assert(sectionInd >= 0 && sectionInd < int(sections_.size()));
+  int sectionNode = model_->sectionNode(CQCheckTreeModel::ROOT_NODE, sectionInd);
+  assert(sectionNode >= 0);
+
+  int subSectionNode = model_->sectionNode(sectionNode, subSectionInd);
 
-  auto *sectionItem = sections_[size_t(sectionInd)];
+  if (subSectionNode < 0)
+    return "";
 
-  return sectionItem->getSectionText(subSectionInd);
+  return model_->nodeText(subSectionNode);
 }
 
 QString
 CQCheckTree::
 getItemText(const CQCheckTreeIndex &ind) const
 {
-  int sectionInd    = ind.sectionInd;
-  int subSectionInd = ind.subSectionInd;
-  int checkInd      = ind.itemInd;
-
-  // toplevel item
-  if (sectionInd < 0 || sectionInd >= int(sections_.size())) {
-    CQCheckTreeCheck *checkItem = nullptr;
-
-    if (checkInd >= 0 && checkInd < int(checks_.size()))
-      checkItem = checks_[size_t(checkInd)];
-
-    return (checkItem ? checkItem->text() : "");
-  }
+  int node = model_->treeIndexNode(ind);
 
-  auto *sectionItem = sections_[size_t(sectionInd)];
+  if (node < 0 || model_->isSection(node))
+    return "";
 
-  if (subSectionInd >= 0)
-    return sectionItem->getItemText(subSectionInd, checkInd);
-  else
-    return sectionItem->getItemText(checkInd);
+  return model_->nodeText(node);
 }
 
-CQCheckTreeItem *
+CQCheckTreeItem
 CQCheckTree::
-getModelItem(const QModelIndex &index) const
+getItem(const CQCheckTreeIndex &ind) const
 {
-  QTreeWidgetItem *item;
-
-  if (! index.parent().isValid())
-    item = tree_->topLevelItem(index.row());
-  else {
-    auto *parent = getModelItem(index.parent());
-    assert(parent);
+  int node = model_->treeIndexNode(ind);
 
-    item = parent->child(index.row());
-  }
+  if (node < 0)
+    return CQCheckTreeItem();
 
-  return dynamic_cast<CQCheckTreeItem *>(item);
+  return CQCheckTreeItem(model_, node);
 }
 
 void
 CQCheckTree::
 itemClicked(const QModelIndex &index)
 {
-  auto *item = getModelItem(index);
-  if (! item) return;
-
-  if (index.column() != 1)
+  if (! index.isValid())
     return;
 
-  if      (item->type() == CQCheckTreeSection::ITEM_ID) {
-    auto *section = dynamic_cast<CQCheckTreeSection *>(item);
-
-    auto checkState = section->checkState();
-
-    section->setChecked(checkState != Qt::Checked);
-
-    tree_->update(index);
+  if (index.column() != CQCheckTreeModel::CHECK_COLUMN)
+    return;
 
-    section->updateInds(index);
+  int node = model_->modelIndexNode(index);
 
-    auto pi = index.parent();
+  // check state changes are repainted through the model's dataChanged
+  if (model_->isSection(node)) {
+    auto checkState = model_->checkState(node);
 
-    while (pi.isValid()) {
-      auto pi1 = tree_->model()->index(pi.row(), 1, pi.parent());
+    model_->setChecked(node, checkState != Qt::Checked);
 
-      tree_->update(pi1);
+    auto ind = model_->treeIndex(node);
 
-      pi = pi.parent();
-    }
+    if      (ind.depth() == 1)
+      Q_EMIT sectionClicked(ind.sectionInd);
+    else if (ind.depth() == 2)
+      Q_EMIT subSectionClicked(ind.sectionInd, ind.subSectionInd);
 
-    if (section->section())
-      Q_EMIT subSectionClicked(section->section()->ind(), section->ind());
-    else
-      Q_EMIT sectionClicked(section->ind());
+    Q_EMIT sectionIndexClicked(ind);
   }
-  else if (item->type() == CQCheckTreeCheck::ITEM_ID) {
-    auto *check = dynamic_cast<CQCheckTreeCheck *>(item);
-
-    check->setChecked(! check->isChecked());
-
-    tree_->update(index);
-
-    auto *section = check->section();
-
-    int sectionInd = (section ? section->ind() : -1);
-
-    auto pi = index.parent();
-
-    while (pi.isValid()) {
-      auto pi1 = tree_->model()->index(pi.row(), 1, pi.parent());
+  else {
+    model_->setChecked(node, ! model_->isChecked(node));
 
-      tree_->update(pi1);
+    Q_EMIT itemClicked(model_->treeIndex(node));
+  }
+}
 
-      pi = pi.parent();
-    }
+void
+CQCheckTree::
+nodeCheckedSlot(int node, bool checked)
+{
+  CQCheckTreeStatsTimer timer(statsCounter(&CQCheckTreeStats::itemChecked));
 
-    if (section && section->section())
-      Q_EMIT itemClicked(CQCheckTreeIndex(section->section()->ind(), sectionInd, check->ind()));
-    else
-      Q_EMIT itemClicked(CQCheckTreeIndex(sectionInd, check->ind()));
-  }
+  Q_EMIT itemChecked(model_->treeIndex(node), checked);
 }
 
 void
 CQCheckTree::
-emitChecked(CQCheckTreeSection *section, int itemNum, bool checked)
+nodesCheckedSlot(const QVector<int> &nodes, bool checked)
 {
-  int sectionInd = (section ? section->ind() : -1);
+  CQCheckTreeStatsTimer timer(statsCounter(&CQCheckTreeStats::itemChecked));
 
-  if (section && section->section())
-    Q_EMIT itemChecked(CQCheckTreeIndex(section->section()->ind(), sectionInd, itemNum), checked);
-  else
-    Q_EMIT itemChecked(CQCheckTreeIndex(sectionInd, itemNum), checked);
+  QVector<CQCheckTreeIndex> inds;
+
+  inds.reserve(nodes.size());
+
+  for (auto node : nodes)
+    inds.push_back(model_->treeIndex(node));
+
+  Q_EMIT itemsChecked(inds, checked);
 }
 
 void
@@ -465,19 +579,30 @@ customContextMenuSlot(const QPoint &pos)
 
   //---
 
-  auto addAction = [&](const QString &text, const char *slotName) {
+  // action object name is the tree slot name (sent by menuActionTriggered)
+  auto addAction = [&](const QString &text, const char *name) {
     auto *action = new QAction(text, menu);
 
-    connect(action, SIGNAL(triggered()), this, slotName);
+    action->setObjectName(name);
+
+    connect(action, SIGNAL(triggered()), this, SLOT(menuActionSlot()));
 
     menu->addAction(action);
 
     return action;
   };
 
-  (void) addAction("Expand All"  , SLOT(expandAll()));
-  (void) addAction("Collapse All", SLOT(collapseAll()));
-  (void) addAction("Fit Columns" , SLOT(fitColumns()));
+  (void) addAction("Expand All"  , "expandAll");
+  (void) addAction("Collapse All", "collapseAll");
+  (void) addAction("Fit Columns" , "fitColumns");
+
+  menu->addSeparator();
+
+  auto *undoAction = addAction("Undo", "undo");
+  auto *redoAction = addAction("Redo", "redo");
+
+  undoAction->setEnabled(model_->canUndo());
+  redoAction->setEnabled(model_->canRedo());
 
   //---
 
@@ -486,16 +611,25 @@ customContextMenuSlot(const QPoint &pos)
   delete menu;
 }
 
+void
+CQCheckTree::
+menuActionSlot()
+{
+  auto name = sender()->objectName();
+
+  Q_EMIT menuActionTriggered(name);
+
+  QMetaObject::invokeMethod(this, name.toLatin1().constData());
+}
+
 void
 CQCheckTree::
 expandAll()
 {
-  for (auto *section : sections()) {
-    tree_->expandItem(section);
+  // no expanded signals are sent so recalc visible widths
+  tree_->expandAll();
 
-    for (auto *section1 : section->sections())
-      tree_->expandItem(section1);
-  }
+  widthsValid_ = false;
 
   fitColumns();
 }
@@ -504,26 +638,46 @@ void
 CQCheckTree::
 collapseAll()
 {
-  for (auto *section : sections()) {
-    tree_->collapseItem(section);
+  tree_->collapseAll();
 
-    for (auto *section1 : section->sections())
-      tree_->collapseItem(section1);
-  }
+  widthsValid_ = false;
 
   fitColumns();
 }
 
+void
+CQCheckTree::
+undo()
+{
+  model_->undo();
+}
+
+void
+CQCheckTree::
+redo()
+{
+  model_->redo();
+}
+
 void
 CQCheckTree::
 fitColumns()
 {
-  // fit columns to contents
-  tree_->resizeColumnToContents(0);
-  tree_->resizeColumnToContents(1);
+  CQCheckTreeStatsTimer timer(statsCounter(&CQCheckTreeStats::fitColumns));
+
+  // fit columns to contents (max visible row width and check size)
+  updateColumnWidths();
 
   auto *header = tree_->header();
 
+  int margin = 2*(tree_->style()->pixelMetric(QStyle::PM_FocusFrameHMargin, nullptr, tree_) + 1);
+
+  int w0 = (! widthCounts_.empty() ? (*widthCounts_.rbegin()).first + margin : 0);
+  int w1 = checkSize() + 4;
+
+  header->resizeSection(0, std::max(w0, header->sectionSizeHint(0)));
+  header->resizeSection(1, std::max(w1, header->sectionSizeHint(1)));
+
   header->setStretchLastSection(false);
   header->setStretchLastSection(true);
 
@@ -555,12 +709,14 @@ void
 CQCheckTree::
 paintEvent(QPaintEvent *e)
 {
-  if (needsFit_) {
+  if (needsFit_ && ! model_->isBulkUpdate()) {
     // force size recalc
     fitSize0_ = -1;
     fitSize1_ = -1;
 
     autoFit();
+
+    needsFit_ = false;
   }
 
   QFrame::paintEvent(e);
@@ -600,520 +756,823 @@ updateClipWidth()
     clipWidth_ = -1;
 }
 
-CQCheckTree::Items
+CQCheckTreeStats
 CQCheckTree::
-getAllItems() const
+stats() const
 {
-  Items items;
+  auto *stats = model_->stats();
 
-  for (auto *section : sections_) {
-    items.push_back(section);
-
-    auto items1 = section->getAllItems();
+  return (stats ? *stats : CQCheckTreeStats());
+}
 
-    for (auto *item1 : items1)
-      items.push_back(item1);
-  }
+void
+CQCheckTree::
+invalidateColumnWidths()
+{
+  labelWidths_.clear();
 
-  for (auto *check : checks_)
-    items.push_back(check);
+  widthsValid_ = false;
+  needsFit_    = true;
 
-  return items;
+  update();
 }
 
-CQCheckTree::Items
+void
 CQCheckTree::
-getCheckedItems() const
+updateColumnWidths()
 {
-  Items items;
-
-  for (auto *section : sections_) {
-    if (section->checkState() == Qt::Checked)
-      items.push_back(section);
-
-    auto items1 = section->getCheckedItems();
+  if (widthsValid_)
+    return;
 
-    for (auto *item1 : items1)
-      items.push_back(item1);
-  }
+  rowWidths_  .clear();
+  widthCounts_.clear();
 
-  for (auto *check : checks_)
-    if (check->isChecked())
-      items.push_back(check);
+  addVisibleWidths(CQCheckTreeModel::ROOT_NODE, true);
 
-  return items;
+  widthsValid_ = true;
 }
 
-//------
-
-CQCheckTreeWidget::
-CQCheckTreeWidget(CQCheckTree *tree) :
- tree_(tree)
+void
+CQCheckTree::
+addVisibleWidths(int node, bool add)
 {
-  setObjectName("tree");
-
-  setSelectionBehavior(QAbstractItemView::SelectItems);
-  setEditTriggers(QAbstractItemView::NoEditTriggers);
-
-  setSelectionMode(QAbstractItemView::NoSelection);
+  // add/remove widths of children of node and of children of expanded child sections
+  int ns = model_->numSections(node);
+  int nc = model_->numChecks  (node);
 
-  //---
+  for (int i = 0; i < ns; ++i) {
+    int section = model_->sectionNode(node, i);
 
-  setItemDelegate(new CQCheckTreeDelegate(tree_));
+    addRowWidth(section, add);
 
-  //---
+    if (tree_->isExpanded(model_->nodeModelIndex(section)))
+      addVisibleWidths(section, add);
+  }
 
-  setHeaderLabels(QStringList() << "Type" << "Selected");
+  for (int i = 0; i < nc; ++i)
+    addRowWidth(model_->checkNode(node, i), add);
 }
 
 void
-CQCheckTreeWidget::
-setHeaderLabels(const QStringList &labels)
+CQCheckTree::
+addRowWidth(int node, bool add)
 {
-  assert(labels.size() == 2);
+  size_t numNodes = size_t(model_->numNodes());
 
-  setColumnCount(2);
+  if (rowWidths_.size() < numNodes)
+    rowWidths_.resize(numNodes, -1);
 
-  QTreeWidget::setHeaderLabels(labels);
-}
-
-QModelIndex
-CQCheckTreeWidget::
-checkIndex(const CQCheckTreeItem *item)
-{
-  return indexFromItem(item, 1);
-}
+  // row counted at most once (fetched rows can be reported as inserted and expanded)
+  auto &rowWidth = rowWidths_[size_t(node)];
 
-//------
+  if (add) {
+    if (rowWidth >= 0)
+      return;
 
-CQCheckTreeDelegate::
-CQCheckTreeDelegate(CQCheckTree *tree) :
- tree_(tree)
-{
-}
+    if (labelWidths_.size() < numNodes)
+      labelWidths_.resize(numNodes, -1);
 
-void
-CQCheckTreeDelegate::
-paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
-{
-  // check
-  if (index.column() == 1) {
-    auto *item = tree_->getModelItem(index);
-    assert(item);
+    auto &labelWidth = labelWidths_[size_t(node)];
 
-    auto checkState = Qt::Unchecked;
+    if (labelWidth < 0)
+      labelWidth = tree_->fontMetrics().horizontalAdvance(model_->nodeText(node));
 
-    if      (item->type() == CQCheckTreeSection::ITEM_ID) {
-      auto *section = dynamic_cast<CQCheckTreeSection *>(item);
+    int depth = model_->nodeDepth(node);
 
-      checkState = section->checkState();
-    }
-    else if (item->type() == CQCheckTreeCheck::ITEM_ID) {
-      auto *check = dynamic_cast<CQCheckTreeCheck *>(item);
+    if (! tree_->rootIsDecorated())
+      --depth;
 
-      checkState = (check->isChecked() ? Qt::Checked : Qt::Unchecked);
-    }
-    else
-      assert(false);
+    rowWidth = tree_->indentation()*depth + labelWidth;
 
-    painter->save();
+    ++widthCounts_[rowWidth];
+  }
+  else {
+    if (rowWidth < 0)
+      return;
 
-    //int checkSize = tree_->style()->pixelMetric(QStyle::PM_IndicatorHeight);
-    int checkSize = tree_->checkSize();
+    auto p = widthCounts_.find(rowWidth);
+    assert(p != widthCounts_.end());
 
-    int dy = (option.rect.height() - checkSize)/2;
+    if (--(*p).second == 0)
+      widthCounts_.erase(p);
 
-    int x = option.rect.left() + 2;
-    int y = option.rect.top () + dy;
+    rowWidth = -1;
+  }
+}
 
-    QRect rect(x, y, checkSize, checkSize);
+bool
+CQCheckTree::
+isNodeVisible(int node) const
+{
+  // all ancestors expanded
+  int parent = model_->parentNode(node);
 
-    drawCheck(painter, option, rect, checkState);
+  while (parent > CQCheckTreeModel::ROOT_NODE) {
+    if (! tree_->isExpanded(model_->nodeModelIndex(parent)))
+      return false;
 
-    painter->restore();
-  }
-  // text
-  else {
-    QItemDelegate::paint(painter, option, index);
+    parent = model_->parentNode(parent);
   }
+
+  return true;
 }
 
-QSize
-CQCheckTreeDelegate::
-sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+void
+CQCheckTree::
+rowsInsertedSlot(const QModelIndex &parent, int first, int last)
 {
-  if (index.column() == 1) {
-    //int checkSize = tree_->style()->pixelMetric(QStyle::PM_IndicatorHeight);
-    int checkSize = tree_->checkSize();
+  needsFit_ = true;
 
-    return QSize(checkSize, checkSize);
+  // inserted rows can reuse ids of removed nodes so discard their cached widths
+  // (new rows have no children yet)
+  for (int row = first; row <= last; ++row) {
+    size_t node = size_t(model_->modelIndexNode(model_->index(row, 0, parent)));
+
+    if (node < labelWidths_.size()) labelWidths_[node] = -1;
+    if (node < rowWidths_  .size()) rowWidths_  [node] = -1;
   }
-  else
-    return QItemDelegate::sizeHint(option, index);
-}
 
-//------
+  // filter inserted rows once per event loop iteration (see filterInsertedSlot)
+  if (! filter_.isEmpty()) {
+    for (int row = first; row <= last; ++row)
+      insertedNodes_.push_back(model_->modelIndexNode(model_->index(row, 0, parent)));
 
-CQCheckTreeSection::
-CQCheckTreeSection(CQCheckTree *tree, const QString &text) :
- CQCheckTreeItem(tree, ITEM_ID), text_(text)
-{
-  setData(0, Qt::DisplayRole, QVariant(text_));
-}
+    if (! filterInsertedPending_) {
+      filterInsertedPending_ = true;
 
-QString
-CQCheckTreeSection::
-hierName() const
-{
-  if (section_)
-    return section_->hierName() + tree_->hierSep() + text();
-  else
-    return text();
+      QMetaObject::invokeMethod(this, "filterInsertedSlot", Qt::QueuedConnection);
+    }
+  }
+
+  if (! widthsValid_)
+    return;
+
+  int node = model_->modelIndexNode(parent);
+
+  if (node != CQCheckTreeModel::ROOT_NODE &&
+      (! tree_->isExpanded(parent) || ! isNodeVisible(node)))
+    return;
+
+  for (int row = first; row <= last; ++row)
+    addRowWidth(model_->modelIndexNode(model_->index(row, 0, parent)), true);
 }
 
-Qt::CheckState
-CQCheckTreeSection::
-checkState() const
+void
+CQCheckTree::
+rowsAboutToBeRemovedSlot(const QModelIndex &parent, int first, int last)
 {
-  uint numSectionsChecked = 0;
+  needsFit_ = true;
 
-  for (uint i = 0; i < sections_.size(); ++i) {
-    auto state = sections_[i]->checkState();
+  if (! widthsValid_)
+    return;
 
-    if (state == Qt::PartiallyChecked)
-      return state;
+  // remove widths of visible removed rows (and expanded descendants)
+  int node = model_->modelIndexNode(parent);
 
-    if (state == Qt::Checked)
-      ++numSectionsChecked;
-  }
+  if (node != CQCheckTreeModel::ROOT_NODE &&
+      (! tree_->isExpanded(parent) || ! isNodeVisible(node)))
+    return;
 
-  uint numChecked = 0;
+  for (int row = first; row <= last; ++row) {
+    auto index = model_->index(row, 0, parent);
 
-  for (uint i = 0; i < checks_.size(); ++i)
-    if (checks_[i]->isChecked())
-      ++numChecked;
+    int node1 = model_->modelIndexNode(index);
 
-  if      (numSectionsChecked == 0 && numChecked == 0)
-    return Qt::Unchecked;
-  else if (numSectionsChecked == sections_.size() && numChecked == checks_.size())
-    return Qt::Checked;
-  else
-    return Qt::PartiallyChecked;
+    addRowWidth(node1, false);
+
+    if (model_->isSection(node1) && tree_->isExpanded(index))
+      addVisibleWidths(node1, false);
+  }
 }
 
 void
-CQCheckTreeSection::
-setChecked(bool checked)
+CQCheckTree::
+rowsRemovedSlot()
 {
-  for (uint i = 0; i < sections_.size(); ++i)
-    sections_[i]->setChecked(checked);
+  // drop removed nodes from filter state (view has discarded their rows)
+  auto isRemoved = [&](int node) { return ! model_->isValidNode(node); };
 
-  for (uint i = 0; i < checks_.size(); ++i)
-    checks_[i]->setChecked(checked);
+  hiddenNodes_.erase(std::remove_if(hiddenNodes_.begin(), hiddenNodes_.end(), isRemoved),
+                     hiddenNodes_.end());
 
-  updateCheck();
+  filterMatches_.erase(std::remove_if(filterMatches_.begin(), filterMatches_.end(), isRemoved),
+                       filterMatches_.end());
 
-  emitDataChanged();
+  insertedNodes_.erase(std::remove_if(insertedNodes_.begin(), insertedNodes_.end(), isRemoved),
+                       insertedNodes_.end());
 }
 
-int
-CQCheckTreeSection::
-addSection(const QString &section)
+void
+CQCheckTree::
+modelResetSlot()
 {
-  auto *sectionItem = new CQCheckTreeSection(tree_, section);
+  // node ids are reused after reset
+  labelWidths_.clear();
 
-  addChild(sectionItem);
+  widthsValid_ = false;
 
-  sections_.push_back(sectionItem);
+  // view has unhidden all rows so filter new nodes
+  hiddenNodes_  .clear();
+  filterMatches_.clear();
+  insertedNodes_.clear();
 
-  int n = int(sections_.size() - 1);
+  if (! filter_.isEmpty()) {
+    if (filterFuzzy_) {
+      matcher_->match(filter_, maxFuzzyMatches_);
+      return;
+    }
+
+    filterMatches_ = model_->findNodes(filter_);
+
+    applyFilter();
+  }
+}
 
-  sectionItem->setSection(this);
+//---
 
-  sectionItem->setInd(n);
+bool
+CQCheckTree::
+isFilterVisible() const
+{
+  // not isVisible (false until top level window is shown)
+  return ! filterEdit_->isHidden();
+}
 
-  return n;
+void
+CQCheckTree::
+setFilterVisible(bool b)
+{
+  filterEdit_->setVisible(b);
 }
 
-CQCheckTreeCheck *
-CQCheckTreeSection::
-addCheck(int sectionInd, const QString &text)
+void
+CQCheckTree::
+setFilterFuzzy(bool b)
 {
-  assert(sectionInd >= 0 && sectionInd < int(sections_.size()));
+  if (b == filterFuzzy_)
+    return;
 
-  //---
+  filterFuzzy_ = b;
 
-  // add section item
-  auto *sectionItem = sections_[size_t(sectionInd)];
+  if (filterFuzzy_ && ! matcher_) {
+    matcher_ = new CQCheckTreeFuzzyMatcher(model_);
+
+    connect(matcher_, SIGNAL(matched(const QVector<CQCheckTreeFuzzyMatch> &)),
+            this, SLOT(fuzzyMatchedSlot(const QVector<CQCheckTreeFuzzyMatch> &)));
+  }
 
-  auto *checkItem = new CQCheckTreeCheck(tree_, sectionItem, text);
+  if (! filterFuzzy_ && matcher_)
+    matcher_->cancel();
 
-  int itemInd = sectionItem->addCheck(checkItem);
+  // re-apply
+  auto text = filter_;
 
-  checkItem->setInd(itemInd);
+  filter_.clear();
 
-  return checkItem;
+  setFilter(text);
 }
 
-int
-CQCheckTreeSection::
-addCheck(CQCheckTreeCheck *check)
+void
+CQCheckTree::
+setFilter(const QString &text)
 {
-  addChild(check);
+  if (text == filter_)
+    return;
 
-  checks_.push_back(check);
+  // fuzzy matches are applied when worker finishes (cancels previous query)
+  if (filterFuzzy_) {
+    filter_ = text;
 
-  return int(checks_.size() - 1);
-}
+    if (filterEdit_->text() != filter_)
+      filterEdit_->setText(filter_);
 
-bool
-CQCheckTreeSection::
-isItemChecked(int checkInd) const
-{
-  if (checkInd < 0 || checkInd >= int(checks_.size()))
-    return false;
+    if (filter_.isEmpty()) {
+      matcher_->cancel();
 
-  auto *checkItem = checks_[size_t(checkInd)];
+      filterMatches_.clear();
 
-  return checkItem->isChecked();
-}
+      applyFilter();
+    }
+    else
+      matcher_->match(filter_, maxFuzzyMatches_);
 
-bool
-CQCheckTreeSection::
-isItemChecked(int sectionInd, int checkInd) const
-{
-  assert(sectionInd >= 0 && sectionInd < int(sections_.size()));
+    return;
+  }
+
+  // refine previous matches while text is extended (matches are a subset)
+  bool refine = (! filter_.isEmpty() && text.startsWith(filter_, Qt::CaseInsensitive) &&
+                 ! text.contains(hierSep()));
+
+  filter_ = text;
+
+  if      (filter_.isEmpty())
+    filterMatches_.clear();
+  else if (refine)
+    filterMatches_ = model_->findNodes(filter_, filterMatches_);
+  else {
+    model_->setSearchIndexed(true);
 
-  auto *subSection = sections_[size_t(sectionInd)];
+    filterMatches_ = model_->findNodes(filter_);
+  }
+
+  if (filterEdit_->text() != filter_)
+    filterEdit_->setText(filter_);
 
-  return subSection->isItemChecked(checkInd);
+  applyFilter();
 }
 
 void
-CQCheckTreeSection::
-setItemChecked(int checkInd, bool checked)
+CQCheckTree::
+fuzzyMatchedSlot(const QVector<CQCheckTreeFuzzyMatch> &matches)
 {
-  if (checkInd < 0 || checkInd >= int(checks_.size()))
+  if (! filterFuzzy_ || filter_.isEmpty())
     return;
 
-  auto *checkItem = checks_[size_t(checkInd)];
+  filterMatches_.clear();
 
-  checkItem->setChecked(checked);
+  // query may have run on a snapshot taken before nodes were removed
+  for (const auto &match : matches)
+    if (model_->isValidNode(match.node))
+      filterMatches_.push_back(match.node);
 
-  checkItem->updateCheck();
+  std::sort(filterMatches_.begin(), filterMatches_.end());
+
+  applyFilter();
 }
 
 void
-CQCheckTreeSection::
-setItemChecked(int sectionInd, int checkInd, bool checked)
+CQCheckTree::
+filterInsertedSlot()
 {
-  assert(sectionInd >= 0 && sectionInd < int(sections_.size()));
+  filterInsertedPending_ = false;
+
+  std::vector<int> nodes;
+
+  std::swap(nodes, insertedNodes_);
+
+  if (filter_.isEmpty() || nodes.empty())
+    return;
+
+  // fuzzy scores are relative to all nodes so re-run query
+  if (filterFuzzy_) {
+    matcher_->match(filter_, maxFuzzyMatches_);
+    return;
+  }
+
+  // add descendants of inserted sections (only top rows are signalled)
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    int node = nodes[i];
+
+    if (! model_->isValidNode(node) || ! model_->isSection(node))
+      continue;
+
+    int ns = model_->numSections(node);
+    int nc = model_->numChecks  (node);
+
+    for (int j = 0; j < ns; ++j)
+      nodes.push_back(model_->sectionNode(node, j));
+
+    for (int j = 0; j < nc; ++j)
+      nodes.push_back(model_->checkNode(node, j));
+  }
+
+  std::sort(nodes.begin(), nodes.end());
 
-  auto *subSection = sections_[size_t(sectionInd)];
+  nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
 
-  subSection->setItemChecked(checkInd, checked);
+  // merge new matches (increasing) into matches and hide the rest in one pass
+  auto matches = model_->findNodes(filter_, nodes);
+
+  std::vector<int> filterMatches;
+
+  std::set_union(filterMatches_.begin(), filterMatches_.end(),
+                 matches.begin(), matches.end(), std::back_inserter(filterMatches));
+
+  filterMatches_ = std::move(filterMatches);
+
+  applyFilter();
 }
 
-QString
-CQCheckTreeSection::
-getItemText(int sectionInd, int checkInd) const
+void
+CQCheckTree::
+applyFilter()
 {
-  assert(sectionInd >= 0 && sectionInd < int(sections_.size()));
+  enum { HIDDEN = 0, PARTIAL = 1, SHOWN = 2 };
+
+  int numNodes = model_->numNodes();
+
+  // visibility: matches and their subtrees shown, ancestors of matches partial
+  std::vector<char> state(size_t(numNodes), char(filter_.isEmpty() ? SHOWN : HIDDEN));
+
+  if (! filter_.isEmpty()) {
+    state[CQCheckTreeModel::ROOT_NODE] = PARTIAL;
+
+    for (auto node : filterMatches_) {
+      state[size_t(node)] = SHOWN;
+
+      int parent = model_->parentNode(node);
+
+      while (parent > CQCheckTreeModel::ROOT_NODE && state[size_t(parent)] == HIDDEN) {
+        state[size_t(parent)] = PARTIAL;
+
+        parent = model_->parentNode(parent);
+      }
+    }
+  }
+
+  // hidden rows are the hidden children of partially shown sections
+  std::vector<int> hiddenNodes;
+
+  std::vector<int> sections;
+
+  if (! filter_.isEmpty())
+    sections.push_back(CQCheckTreeModel::ROOT_NODE);
 
-  auto *subSection = sections_[size_t(sectionInd)];
+  while (! sections.empty()) {
+    int section = sections.back();
 
-  return subSection->getItemText(checkInd);
+    sections.pop_back();
+
+    int ns = model_->numSections(section);
+    int nc = model_->numChecks  (section);
+
+    for (int i = 0; i < ns; ++i) {
+      int node = model_->sectionNode(section, i);
+
+      if      (state[size_t(node)] == HIDDEN)
+        hiddenNodes.push_back(node);
+      else if (state[size_t(node)] == PARTIAL)
+        sections.push_back(node);
+    }
+
+    for (int i = 0; i < nc; ++i) {
+      int node = model_->checkNode(section, i);
+
+      if (state[size_t(node)] == HIDDEN)
+        hiddenNodes.push_back(node);
+    }
+  }
+
+  //---
+
+  // only update rows whose hidden state changed (reuse state for marks)
+  enum { WAS_HIDDEN = 4, IS_HIDDEN = 8 };
+
+  for (auto node : hiddenNodes_)
+    state[size_t(node)] |= WAS_HIDDEN;
+
+  for (auto node : hiddenNodes)
+    state[size_t(node)] |= IS_HIDDEN;
+
+  tree_->setUpdatesEnabled(false);
+
+  for (auto node : hiddenNodes_) {
+    if (! (state[size_t(node)] & IS_HIDDEN))
+      tree_->setRowHidden(model_->nodeRow(node),
+                          model_->nodeModelIndex(model_->parentNode(node)), false);
+  }
+
+  for (auto node : hiddenNodes) {
+    if (! (state[size_t(node)] & WAS_HIDDEN))
+      tree_->setRowHidden(model_->nodeRow(node),
+                          model_->nodeModelIndex(model_->parentNode(node)), true);
+  }
+
+  tree_->setUpdatesEnabled(true);
+
+  std::swap(hiddenNodes_, hiddenNodes);
 }
 
-QString
-CQCheckTreeSection::
-getItemText(int checkInd) const
+void
+CQCheckTree::
+expandedSlot(const QModelIndex &index)
 {
-  if (checkInd < 0 || checkInd >= int(checks_.size()))
-    return "";
+  int node = model_->modelIndexNode(index);
 
-  auto *checkItem = checks_[size_t(checkInd)];
+  if (widthsValid_ && isNodeVisible(node))
+    addVisibleWidths(node, true);
 
-  return checkItem->text();
+  needsFit_ = true;
 }
 
 void
-CQCheckTreeSection::
-emitChecked(CQCheckTreeCheck *check, bool checked)
+CQCheckTree::
+collapsedSlot(const QModelIndex &index)
 {
-  int checkInd = this->checkInd(check);
+  int node = model_->modelIndexNode(index);
 
-  if (checkInd >= 0)
-    tree_->emitChecked(this, checkInd, checked);
+  if (widthsValid_ && isNodeVisible(node))
+    addVisibleWidths(node, false);
+
+  needsFit_ = true;
 }
 
-int
-CQCheckTreeSection::
-checkInd(CQCheckTreeCheck *check) const
+CQCheckTree::Items
+CQCheckTree::
+getAllItems() const
 {
-  for (uint i = 0; i < checks_.size(); ++i)
-    if (checks_[i] == check)
-      return int(i);
+  return model_->getAllItems();
+}
 
-  return -1;
+CQCheckTree::Items
+CQCheckTree::
+getCheckedItems() const
+{
+  return model_->getCheckedItems();
 }
 
-bool
-CQCheckTreeSection::
-hasSection(int sectionInd) const
+//------
+
+CQCheckTreeWidget::
+CQCheckTreeWidget(CQCheckTree *tree) :
+ tree_(tree)
 {
-  return (sectionInd >= 0 && sectionInd < int(sections_.size()));
+  setObjectName("tree");
+
+  setSelectionBehavior(QAbstractItemView::SelectItems);
+  setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+  setSelectionMode(QAbstractItemView::NoSelection);
+
+  // all rows are single line text or check so skip per row size queries
+  setUniformRowHeights(true);
+
+  //---
+
+  setModel(tree_->model());
+
+  delegate_ = new CQCheckTreeDelegate(tree_);
+
+  setItemDelegate(delegate_);
+
+  //---
+
+  setHeaderLabels(QStringList() << "Type" << "Selected");
 }
 
-QString
-CQCheckTreeSection::
-getSectionText(int sectionInd) const
+void
+CQCheckTreeWidget::
+setHeaderLabels(const QStringList &labels)
 {
-  if (sectionInd < 0 || sectionInd >= int(sections_.size()))
-    return "";
+  assert(labels.size() == 2);
 
-  auto *sectionItem = sections_[size_t(sectionInd)];
+  tree_->model()->setHeaders(labels);
+}
 
-  return sectionItem->text();
+QModelIndex
+CQCheckTreeWidget::
+checkIndex(const CQCheckTreeItem &item) const
+{
+  return tree_->model()->nodeModelIndex(item.node(), CQCheckTreeModel::CHECK_COLUMN);
 }
 
 void
-CQCheckTreeSection::
-updateInds(const QModelIndex &parent) const
+CQCheckTreeWidget::
+changeEvent(QEvent *e)
 {
-  for (uint i = 0; i < sections_.size(); ++i) {
-    auto pos = indexOfChild(sections_[i]);
+  // palette and device pixel ratio are part of glyph cache key but style and
+  // font changes are not
+  if (e->type() == QEvent::StyleChange || e->type() == QEvent::FontChange) {
+    delegate_->invalidateGlyphs();
 
-    auto ind = parent.model()->index(pos, 1, parent);
+    tree_->invalidateColumnWidths();
+  }
 
-    tree_->tree()->update(ind);
+  QTreeView::changeEvent(e);
+}
 
-    sections_[i]->updateInds(ind);
+void
+CQCheckTreeWidget::
+dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
+{
+  // accessibility needs per change events
+  if (QAccessible::isActive()) {
+    QTreeView::dataChanged(topLeft, bottomRight, roles);
+    return;
   }
 
-  for (uint i = 0; i < checks_.size(); ++i) {
-    auto pos = indexOfChild(checks_[i]);
+  if (! topLeft.isValid() || ! bottomRight.isValid())
+    return;
 
-    auto ind = parent.model()->index(pos, 1, parent);
+  auto *model = tree_->model();
 
-    tree_->tree()->update(ind);
-  }
-}
+  // add to parent's changed row range
+  int parent = model->modelIndexNode(topLeft.parent());
 
-CQCheckTree::Items
-CQCheckTreeSection::
-getAllItems() const
-{
-  Items items;
+  int row1 = topLeft    .row();
+  int row2 = bottomRight.row();
 
-  for (auto *section : sections_) {
-    items.push_back(section);
+  auto p = dirtyRows_.find(parent);
 
-    auto items1 = section->getAllItems();
+  if (p == dirtyRows_.end())
+    dirtyRows_[parent] = RowRange(row1, row2);
+  else {
+    auto &range = (*p).second;
 
-    for (auto *item1 : items1)
-      items.push_back(item1);
+    range.first  = std::min(range.first , row1);
+    range.second = std::max(range.second, row2);
   }
 
-  for (auto *check : checks_)
-    items.push_back(check);
+  if (! flushPending_) {
+    flushPending_ = true;
 
-  return items;
+    QMetaObject::invokeMethod(this, "flushUpdates", Qt::QueuedConnection);
+  }
 }
 
-CQCheckTree::Items
-CQCheckTreeSection::
-getCheckedItems() const
+void
+CQCheckTreeWidget::
+flushUpdates()
 {
-  Items items;
+  flushPending_ = false;
+
+  DirtyRows dirtyRows;
+
+  std::swap(dirtyRows, dirtyRows_);
+
+  auto *model = tree_->model();
+
+  auto *vp = viewport();
+
+  int w = vp->width();
+  int h = vp->height();
 
-  for (auto *section : sections_) {
-    if (section->checkState() == Qt::Checked)
-      items.push_back(section);
+  // vertical spans of changed rows in viewport (rows of a range are contiguous
+  // apart from expanded children between them)
+  std::vector<RowRange> spans;
 
-    auto items1 = section->getCheckedItems();
+  for (const auto &pr : dirtyRows) {
+    int parent = pr.first;
 
-    for (auto *item1 : items1)
-      items.push_back(item1);
+    // rows of removed parent are gone
+    if (! model->isValidNode(parent))
+      continue;
+
+    auto parentInd = model->nodeModelIndex(parent);
+
+    int numRows = model->rowCount(parentInd);
+
+    int row1 = pr.second.first;
+    int row2 = std::min(pr.second.second, numRows - 1);
+
+    if (row1 > row2)
+      continue;
+
+    // rows are not visible if any ancestor section is collapsed or hidden
+    bool visible = true;
+
+    for (int node = parent; visible && node > CQCheckTreeModel::ROOT_NODE;
+           node = model->parentNode(node)) {
+      auto ind = model->nodeModelIndex(node);
+
+      visible = (isExpanded(ind) && ! isRowHidden(ind.row(), ind.parent()));
+    }
+
+    if (! visible)
+      continue;
+
+    // skip hidden (filtered) end rows
+    while (row1 <= row2 && isRowHidden(row1, parentInd))
+      ++row1;
+
+    while (row2 >= row1 && isRowHidden(row2, parentInd))
+      --row2;
+
+    if (row1 > row2)
+      continue;
+
+    auto rect1 = visualRect(model->index(row1, 0, parentInd));
+    auto rect2 = visualRect(model->index(row2, 0, parentInd));
+
+    // not laid out yet (layout repaints viewport)
+    if (! rect1.isValid() || ! rect2.isValid())
+      continue;
+
+    int y1 = std::max(rect1.top   (), 0);
+    int y2 = std::min(rect2.bottom(), h - 1);
+
+    if (y1 <= y2)
+      spans.push_back(RowRange(y1, y2));
   }
 
-  for (auto *check : checks_)
-    if (check->isChecked())
-      items.push_back(check);
+  // merge overlapping and adjacent spans into minimal set of rectangles
+  std::sort(spans.begin(), spans.end());
 
-  return items;
-}
+  size_t i = 0;
 
-//------
+  while (i < spans.size()) {
+    int y1 = spans[i].first;
+    int y2 = spans[i].second;
 
-CQCheckTreeCheck::
-CQCheckTreeCheck(CQCheckTree *tree, CQCheckTreeSection *section, const QString &text) :
- CQCheckTreeItem(tree, ITEM_ID), section_(section), text_(text)
-{
-  setData(0, Qt::DisplayRole, QVariant(text_));
+    for (++i; i < spans.size() && spans[i].first <= y2 + 1; ++i)
+      y2 = std::max(y2, spans[i].second);
+
+    vp->update(QRect(0, y1, w, y2 - y1 + 1));
+  }
 }
 
-QString
-CQCheckTreeCheck::
-hierName() const
+//------
+
+CQCheckTreeDelegate::
+CQCheckTreeDelegate(CQCheckTree *tree) :
+ tree_(tree)
 {
-  if (section_)
-    return section_->hierName() + tree_->hierSep() + text();
-  else
-    return text();
 }
 
 void
-CQCheckTreeCheck::
-setChecked(bool checked)
+CQCheckTreeDelegate::
+paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
 {
-  if (checked_ == checked)
-    return;
+  CQCheckTreeStatsTimer timer(tree_->statsCounter(&CQCheckTreeStats::paint));
 
-  checked_ = checked;
+  // check
+  if (index.column() == CQCheckTreeModel::CHECK_COLUMN) {
+    auto *model = tree_->model();
 
-  if (section_)
-    section_->emitChecked(this, checked_);
-  else
-    tree_->emitChecked(nullptr, ind(), checked_);
+    int node = model->modelIndexNode(index);
 
-  emitDataChanged();
-}
+    auto checkState = model->checkState(node);
 
-//------
+    //int checkSize = tree_->style()->pixelMetric(QStyle::PM_IndicatorHeight);
+    int checkSize = tree_->checkSize();
 
-CQCheckTreeItem::
-CQCheckTreeItem(CQCheckTree *tree, int id) :
- QTreeWidgetItem(id), tree_(tree)
-{
+    int dy = (option.rect.height() - checkSize)/2;
+
+    int x = option.rect.left() + 2;
+    int y = option.rect.top () + dy;
+
+    // blit cached glyph (no painter state change)
+    painter->drawPixmap(x, y, checkGlyph(painter, option, checkState));
+  }
+  // text
+  else {
+    QItemDelegate::paint(painter, option, index);
+  }
 }
 
-QModelIndex
-CQCheckTreeItem::
-modelIndex() const
+QSize
+CQCheckTreeDelegate::
+sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
 {
-  auto *tree = tree_->tree();
+  if (index.column() == CQCheckTreeModel::CHECK_COLUMN) {
+    //int checkSize = tree_->style()->pixelMetric(QStyle::PM_IndicatorHeight);
+    int checkSize = tree_->checkSize();
 
-  return tree->checkIndex(this);
+    return QSize(checkSize, checkSize);
+  }
+  else
+    return QItemDelegate::sizeHint(option, index);
 }
 
-void
-CQCheckTreeItem::
-updateCheck()
+const QPixmap &
+CQCheckTreeDelegate::
+checkGlyph(QPainter *painter, const QStyleOptionViewItem &option,
+           Qt::CheckState checkState) const
 {
-  auto *tree = tree_->tree();
+  GlyphKey key;
+
+  key.checkSize = tree_->checkSize();
+  key.dpr       = (painter->device() ? painter->device()->devicePixelRatioF() : 1.0);
+  key.palette   = option.palette.cacheKey();
+  key.enabled   = (option.state & QStyle::State_Enabled);
+
+  if (! (key == glyphKey_)) {
+    for (auto &glyph : glyphs_)
+      glyph = QPixmap();
+
+    glyphKey_ = key;
+  }
+
+  auto &glyph = glyphs_[int(checkState)];
 
-  auto index = modelIndex();
+  if (glyph.isNull()) {
+    int size = key.checkSize;
 
-  tree->update(index);
+    glyph = QPixmap(int(size*key.dpr), int(size*key.dpr));
 
-  auto pi = index.parent();
+    glyph.setDevicePixelRatio(key.dpr);
 
-  while (pi.isValid()) {
-    auto pi1 = tree->model()->index(pi.row(), 1, pi.parent());
+    glyph.fill(Qt::transparent);
 
-    tree->update(pi1);
+    // render with state independent of hover/focus so glyph can be shared
+    QStyleOptionViewItem option1(option);
 
-    pi = pi.parent();
+    option1.state = (key.enabled ? QStyle::State_Enabled : QStyle::State_None);
+
+    QPainter painter1(&glyph);
+
+    drawCheck(&painter1, option1, QRect(0, 0, size, size), checkState);
   }
+
+  return glyph;
+}
+
+void
+CQCheckTreeDelegate::
+invalidateGlyphs()
+{
+  glyphKey_ = GlyphKey();
+
+  for (auto &glyph : glyphs_)
+    glyph = QPixmap();
 }
@@ -8,12 +8,14 @@ DEPENDPATH += .
 
 CONFIG += staticlib
 
-# Input
+# Input (widget layer, core is built by CQCheckTreeCore.pro)
 HEADERS += \
 ../include/CQCheckTree.h \
+../include/CQCheckTreeRecorder.h \
 
 SOURCES += \
 CQCheckTree.cpp \
+CQCheckTreeRecorder.cpp \
 
 OBJECTS_DIR = ../obj
 
@@ -0,0 +1,34 @@
+TEMPLATE = lib
+
+QT = core
+
+TARGET = CQCheckTreeCore
+
+DEPENDPATH += .
+
+CONFIG += staticlib
+
+# Input
+HEADERS += \
+../include/CQCheckTreeModel.h \
+../include/CQCheckTreeBits.h \
+../include/CQCheckTreeChunks.h \
+../include/CQCheckTreeProvider.h \
+../include/CQCheckTreeSearchIndex.h \
+../include/CQCheckTreeFuzzyMatcher.h \
+../include/CQCheckTreeSnapshot.h \
+../include/CQCheckTreeStats.h \
+
+SOURCES += \
+CQCheckTreeModel.cpp \
+CQCheckTreeSearchIndex.cpp \
+CQCheckTreeFuzzyMatcher.cpp \
+CQCheckTreeSnapshot.cpp \
+
+OBJECTS_DIR = ../obj/core
+
+DESTDIR = ../lib
+
+INCLUDEPATH += \
+. \
+../include \
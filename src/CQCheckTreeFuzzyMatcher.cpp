@@ -0,0 +1,239 @@
+#include <CQCheckTreeFuzzyMatcher.h>
+#include <QRunnable>
+
+#include <algorithm>
+#include <queue>
+
+// scores all nodes of snapshot against query parts on worker thread
+class CQCheckTreeFuzzyRunner : public QRunnable {
+ public:
+  using Matches = CQCheckTreeFuzzyMatcher::Matches;
+
+ public:
+  CQCheckTreeFuzzyRunner(CQCheckTreeFuzzyMatcher *matcher,
+                         const CQCheckTreeModel::StructureSnapshotP &snapshot,
+                         const QStringList &parts, int maxMatches, int generation) :
+   matcher_(matcher), snapshot_(snapshot), parts_(parts), maxMatches_(maxMatches),
+   generation_(generation) {
+  }
+
+  void run() override;
+
+ private:
+  int nodeScore(int node) const;
+
+ private:
+  CQCheckTreeFuzzyMatcher*             matcher_    { nullptr };
+  CQCheckTreeModel::StructureSnapshotP snapshot_;
+  QStringList                          parts_;
+  int                                  maxMatches_ { 0 };
+  int                                  generation_ { 0 };
+};
+
+//---
+
+CQCheckTreeFuzzyMatcher::
+CQCheckTreeFuzzyMatcher(CQCheckTreeModel *model) :
+ QObject(model), model_(model)
+{
+  setObjectName("fuzzyMatcher");
+
+  qRegisterMetaType<QVector<CQCheckTreeFuzzyMatch>>("QVector<CQCheckTreeFuzzyMatch>");
+
+  // queries are serialized (stale queries stop at next cancel check)
+  pool_.setMaxThreadCount(1);
+
+  connect(this, SIGNAL(resultsReady(int, const QVector<CQCheckTreeFuzzyMatch> &)),
+          this, SLOT(resultsSlot(int, const QVector<CQCheckTreeFuzzyMatch> &)),
+          Qt::QueuedConnection);
+}
+
+CQCheckTreeFuzzyMatcher::
+~CQCheckTreeFuzzyMatcher()
+{
+  cancel();
+
+  // worker uses this object to send results
+  pool_.waitForDone();
+}
+
+void
+CQCheckTreeFuzzyMatcher::
+match(const QString &text, int maxMatches)
+{
+  int generation = generation_.fetchAndAddOrdered(1) + 1;
+
+  QStringList parts;
+
+  for (const auto &part : text.toLower().split(model_->hierSep()))
+    if (! part.isEmpty())
+      parts << part;
+
+  if (parts.isEmpty() || maxMatches <= 0) {
+    Q_EMIT matched(Matches());
+    return;
+  }
+
+  // snapshot is shared by queries until model structure changes
+  pool_.start(new CQCheckTreeFuzzyRunner(this, model_->structureSnapshot(), parts,
+                                         maxMatches, generation));
+}
+
+void
+CQCheckTreeFuzzyMatcher::
+cancel()
+{
+  generation_.fetchAndAddOrdered(1);
+}
+
+void
+CQCheckTreeFuzzyMatcher::
+resultsSlot(int generation, const QVector<CQCheckTreeFuzzyMatch> &matches)
+{
+  // ignore results of stale query
+  if (! isCurrent(generation))
+    return;
+
+  Q_EMIT matched(matches);
+}
+
+int
+CQCheckTreeFuzzyMatcher::
+matchScore(const QChar *label, int len, const QString &text)
+{
+  // sum of per character scores with bonuses for label start, consecutive
+  // characters and word starts, less a small penalty for label length
+  int n = text.length();
+
+  if (n > len)
+    return -1;
+
+  int score = 0;
+  int i     = 0;
+  int prev  = -2;
+
+  for (int j = 0; j < len && i < n; ++j) {
+    if (label[j].toLower() != text[i])
+      continue;
+
+    int bonus = 1;
+
+    if      (j == 0)
+      bonus += 8;
+    else if (prev == j - 1)
+      bonus += 5;
+    else if (! label[j - 1].isLetterOrNumber() ||
+             (label[j].isUpper() && label[j - 1].isLower()))
+      bonus += 4;
+
+    score += bonus;
+
+    prev = j;
+
+    ++i;
+  }
+
+  if (i < n)
+    return -1;
+
+  return 16*score - (len - n);
+}
+
+//---
+
+void
+CQCheckTreeFuzzyRunner::
+run()
+{
+  // min heap of best matches (lowest score on top)
+  auto cmp = [](const CQCheckTreeFuzzyMatch &lhs, const CQCheckTreeFuzzyMatch &rhs) {
+    if (lhs.score != rhs.score)
+      return lhs.score > rhs.score;
+
+    return lhs.node < rhs.node;
+  };
+
+  std::priority_queue<CQCheckTreeFuzzyMatch, std::vector<CQCheckTreeFuzzyMatch>,
+                      decltype(cmp)> best(cmp);
+
+  int numNodes = int(snapshot_->nodes.size());
+
+  for (int node = CQCheckTreeModel::ROOT_NODE + 1; node < numNodes; ++node) {
+    // check for newer query
+    if ((node & 1023) == 0 && ! matcher_->isCurrent(generation_))
+      return;
+
+    int score = nodeScore(node);
+
+    if (score < 0)
+      continue;
+
+    if (int(best.size()) < maxMatches_)
+      best.push(CQCheckTreeFuzzyMatch(node, score));
+    else if (score > best.top().score) {
+      best.pop();
+
+      best.push(CQCheckTreeFuzzyMatch(node, score));
+    }
+  }
+
+  Matches matches;
+
+  matches.resize(int(best.size()));
+
+  for (int i = matches.size() - 1; i >= 0; --i) {
+    matches[i] = best.top();
+
+    best.pop();
+  }
+
+  // queued to matcher's thread
+  Q_EMIT matcher_->resultsReady(generation_, matches);
+}
+
+int
+CQCheckTreeFuzzyRunner::
+nodeScore(int node) const
+{
+  const auto &nodes  = snapshot_->nodes;
+  const auto *labels = snapshot_->labels.constData();
+
+  // last part must match node label
+  int i = parts_.size() - 1;
+
+  const auto &n = nodes[size_t(node)];
+
+  if (n.removed)
+    return -1;
+
+  int score = CQCheckTreeFuzzyMatcher::matchScore(labels + n.labelOffset,
+                                                  int(n.labelLength), parts_[i]);
+
+  if (score < 0)
+    return -1;
+
+  // remaining parts match ancestor labels (deepest first)
+  --i;
+
+  int parent = n.parent;
+
+  while (i >= 0 && parent > CQCheckTreeModel::ROOT_NODE) {
+    const auto &pn = nodes[size_t(parent)];
+
+    int score1 = CQCheckTreeFuzzyMatcher::matchScore(labels + pn.labelOffset,
+                                                     int(pn.labelLength), parts_[i]);
+
+    if (score1 >= 0) {
+      score += score1;
+
+      --i;
+    }
+
+    parent = pn.parent;
+  }
+
+  if (i >= 0)
+    return -1;
+
+  return score;
+}
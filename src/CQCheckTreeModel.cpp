@@ -0,0 +1,3407 @@
+#include <CQCheckTreeModel.h>
+#include <CQCheckTreeProvider.h>
+#include <CQCheckTreeSnapshot.h>
+
+#include <QDataStream>
+#include <QIODevice>
+#include <QHash>
+#include <QSet>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace {
+
+// separator for section and child keys (independent of hierSep)
+const QChar KEY_SEP(0x1f);
+
+// minimum removed label characters before label buffer is compacted
+const int COMPACT_LABEL_CHARS = 4096;
+
+}
+
+CQCheckTreeModel::
+CQCheckTreeModel(QObject *parent) :
+ QAbstractItemModel(parent)
+{
+  setObjectName("checkTreeModel");
+
+  headers_ << "Type" << "Selected";
+
+  initRoot();
+}
+
+CQCheckTreeModel::
+~CQCheckTreeModel()
+{
+}
+
+void
+CQCheckTreeModel::
+setHierSep(const QChar &v)
+{
+  if (v == hierSep_)
+    return;
+
+  hierSep_ = v;
+
+  // invalidate cached section names and section paths
+  ++hierGen_;
+
+  pathSections_.clear();
+
+  pathSectionsValid_ = false;
+
+  schedulePublish();
+}
+
+void
+CQCheckTreeModel::
+setHeaders(const QStringList &headers)
+{
+  assert(headers.size() == 2);
+
+  headers_ = headers;
+
+  Q_EMIT headerDataChanged(Qt::Horizontal, 0, headers_.size() - 1);
+}
+
+void
+CQCheckTreeModel::
+clear()
+{
+  bool notify = ! isBulkUpdate();
+
+  if (notify)
+    beginResetModel();
+
+  // node, label and section storage is kept so a rebuild does not reallocate
+  // (see squeeze)
+  nodes_.clear();
+
+  // pooled in reverse so a same shaped rebuild reuses sections in order
+  for (auto p = sections_.rbegin(); p != sections_.rend(); ++p) {
+    (*p).recycle();
+
+    sectionPool_.push_back(std::move(*p));
+  }
+
+  sections_.clear();
+
+  freeNodes_   .clear();
+  freeSections_.clear();
+
+  labels_.truncate(0);
+
+  removedChars_ = 0;
+
+  initRoot();
+
+  searchIndex_.clear();
+
+  resetStructure();
+
+  pathSections_.clear();
+
+  pathSectionsValid_ = false;
+
+  clearUndo();
+
+  // section indices are reused so previous states can't be shared
+  snapshotDirty_.clear();
+
+  snapshotReset_ = true;
+
+  if (notify)
+    endResetModel();
+
+  schedulePublish();
+}
+
+void
+CQCheckTreeModel::
+reserve(int numNodes, int numChars)
+{
+  nodes_.reserve(nodes_.size() + size_t(numNodes));
+
+  labels_.reserve(labels_.size() + numChars);
+}
+
+void
+CQCheckTreeModel::
+squeeze()
+{
+  nodes_   .shrink_to_fit();
+  sections_.shrink_to_fit();
+
+  Sections().swap(sectionPool_);
+
+  labels_.squeeze();
+}
+
+void
+CQCheckTreeModel::
+beginBulkUpdate()
+{
+  // views are reset once at end instead of per row insert/data change
+  if (bulkDepth_++ == 0)
+    beginResetModel();
+}
+
+void
+CQCheckTreeModel::
+endBulkUpdate()
+{
+  assert(bulkDepth_ > 0);
+
+  if (--bulkDepth_ == 0) {
+    if (snapshotsEnabled_)
+      publishSnapshot();
+
+    endResetModel();
+  }
+}
+
+void
+CQCheckTreeModel::
+initRoot()
+{
+  Node root;
+
+  root.isSection = 1;
+  root.section   = allocSection();
+
+  nodes_.push_back(root);
+}
+
+int
+CQCheckTreeModel::
+allocSection()
+{
+  // reuse index (and storage) of removed section
+  if (! freeSections_.empty()) {
+    int section = freeSections_.back();
+
+    freeSections_.pop_back();
+
+    return section;
+  }
+
+  // reuse storage of cleared section
+  if (! sectionPool_.empty()) {
+    sections_.push_back(std::move(sectionPool_.back()));
+
+    sectionPool_.pop_back();
+  }
+  else
+    sections_.push_back(Section());
+
+  return int(sections_.size()) - 1;
+}
+
+int
+CQCheckTreeModel::
+allocNode()
+{
+  if (! freeNodes_.empty()) {
+    int node = freeNodes_.back();
+
+    freeNodes_.pop_back();
+
+    return node;
+  }
+
+  return int(nodes_.size());
+}
+
+void
+CQCheckTreeModel::
+setNode(int node, const Node &n)
+{
+  if (size_t(node) == nodes_.size()) {
+    nodes_.push_back(n);
+    return;
+  }
+
+  // reused id (structure copy has removed node)
+  nodes_[size_t(node)] = n;
+
+  markStructureNode(node);
+}
+
+int
+CQCheckTreeModel::
+addSection(int parent, const QString &text)
+{
+  return addNode(parent, text, /*isSection*/true);
+}
+
+int
+CQCheckTreeModel::
+addCheck(int parent, const QString &text)
+{
+  return addNode(parent, text, /*isSection*/false);
+}
+
+int
+CQCheckTreeModel::
+addLazySection(int parent, const QString &text)
+{
+  assert(provider_);
+
+  return addNode(parent, text, /*isSection*/true, /*isLazy*/true);
+}
+
+int
+CQCheckTreeModel::
+addNode(int parent, const QString &text, bool isSection, bool isLazy)
+{
+  assert(isValidNode(parent) && this->isSection(parent) && ! this->isLazy(parent));
+
+  auto oldState = checkState(parent);
+
+  int node = allocNode();
+  int row  = int(nodeSection(parent).children.size());
+
+  bool notify = ! isBulkUpdate();
+
+  if (notify)
+    beginInsertRows(nodeModelIndex(parent), row, row);
+
+  Node n;
+
+  n.parent      = parent;
+  n.row         = row;
+  n.labelOffset = uint(labels_.size());
+  n.labelLength = uint(text.size());
+  n.isSection   = isSection;
+
+  labels_ += text;
+
+  markStructureSection(parent);
+
+  if (searchIndexed_)
+    searchIndex_.addLabel(node, text.constData(), text.size());
+
+  if (isSection)
+    n.section = allocSection();
+
+  // get parent section after adding new section (invalidates references)
+  auto &parentSection = nodeSection(parent);
+
+  parentSection.children.push_back(node);
+
+  if (isSection) {
+    n.ind = int(parentSection.sections.size());
+
+    parentSection.sections.push_back(node);
+  }
+  else {
+    n.ind = int(parentSection.checks.size());
+
+    parentSection.checks.push_back(node);
+
+    parentSection.checkBits.resize(int(parentSection.checks.size()));
+  }
+
+  setNode(node, n);
+
+  // reused section index has stale structure and state in snapshots
+  if (isSection) {
+    markStructureSection(node);
+
+    markSnapshotDirty(node);
+  }
+
+  // lazy section children and state come from provider (set before rows are
+  // inserted so views see the section has children)
+  if (isLazy) {
+    int numChecked = 0, numChecks = 0;
+
+    provider_->checkCounts(this, node, numChecked, numChecks);
+
+    numChecks  = std::max(numChecks, 0);
+    numChecked = std::min(std::max(numChecked, 0), numChecks);
+
+    auto &section = nodeSection(node);
+
+    section.lazy         = true;
+    section.lazyChildren = provider_->childCount(this, node);
+    section.lazyTotal    = uint(numChecks);
+    section.lazyChecked  = uint(numChecked);
+  }
+
+  if (notify)
+    endInsertRows();
+
+  // new child is unchecked so parent state may change
+  updateState(parent, oldState);
+
+  // propagate lazy section state
+  if (isLazy)
+    updateState(node, Qt::Unchecked);
+
+  // first section with path is used for path adds
+  if (isSection && pathSectionsValid_) {
+    auto path = sectionHierName(node);
+
+    if (! pathSections_.contains(path))
+      pathSections_[path] = node;
+  }
+
+  schedulePublish();
+
+  return node;
+}
+
+int
+CQCheckTreeModel::
+addChecks(int parent, const QStringList &texts)
+{
+  assert(isValidNode(parent) && isSection(parent) && ! isLazy(parent));
+
+  if (texts.isEmpty())
+    return -1;
+
+  auto oldState = checkState(parent);
+
+  int node = -1;
+  int n    = texts.size();
+
+  auto &parentSection = nodeSection(parent);
+
+  int row = int(parentSection.children.size());
+  int ind = int(parentSection.checks  .size());
+
+  markStructureSection(parent);
+
+  // single row insert notification for all checks
+  bool notify = ! isBulkUpdate();
+
+  if (notify)
+    beginInsertRows(nodeModelIndex(parent), row, row + n - 1);
+
+  for (int i = 0; i < n; ++i) {
+    const auto &text = texts[i];
+
+    int node1 = allocNode();
+
+    if (i == 0)
+      node = node1;
+
+    Node n1;
+
+    n1.parent      = parent;
+    n1.row         = row + i;
+    n1.ind         = ind + i;
+    n1.labelOffset = uint(labels_.size());
+    n1.labelLength = uint(text.size());
+
+    labels_ += text;
+
+    if (searchIndexed_)
+      searchIndex_.addLabel(node1, text.constData(), text.size());
+
+    parentSection.children.push_back(node1);
+    parentSection.checks  .push_back(node1);
+
+    setNode(node1, n1);
+  }
+
+  parentSection.checkBits.resize(int(parentSection.checks.size()));
+
+  if (notify)
+    endInsertRows();
+
+  updateState(parent, oldState);
+
+  schedulePublish();
+
+  return node;
+}
+
+bool
+CQCheckTreeModel::
+isLazy(int node) const
+{
+  if (! isValidNode(node) || ! isSection(node))
+    return false;
+
+  return nodeSection(node).lazy;
+}
+
+int
+CQCheckTreeModel::
+lazyChildCount(int node) const
+{
+  if (! isLazy(node))
+    return 0;
+
+  return nodeSection(node).lazyChildren;
+}
+
+int
+CQCheckTreeModel::
+lazyCheckCount(int node) const
+{
+  if (! isLazy(node))
+    return 0;
+
+  return int(nodeSection(node).lazyTotal);
+}
+
+void
+CQCheckTreeModel::
+fetchNode(int node)
+{
+  if (! provider_ || ! isLazy(node))
+    return;
+
+  auto oldState = checkState(node);
+
+  auto &section = nodeSection(node);
+
+  int lazyOverride = section.lazyOverride;
+
+  // journaled lazy states of section are rewritten for fetched checks
+  bool journaled = isLazyJournaled(node);
+
+  undoLazy_.erase(std::remove_if(undoLazy_.begin(), undoLazy_.end(),
+                    [&](const UndoLazy &l) { return l.node == node; }), undoLazy_.end());
+
+  section.lazy         = false;
+  section.fetching     = true;
+  section.lazyChildren = 0;
+  section.lazyChecked  = 0;
+  section.lazyTotal    = 0;
+  section.lazyOverride = -1;
+
+  // children are added and set to their initial state without check signals
+  // and without changing parent state (updated once from net change at end)
+  ++fetchDepth_;
+
+  provider_->fetchChildren(this, node);
+
+  // initial state of fetched subtree (state of journaled unset lazy state)
+  SubtreeStates initStates;
+
+  if (journaled)
+    getSubtreeStates(node, initStates);
+
+  // apply check state set before fetch
+  if (lazyOverride >= 0)
+    setChecked(node, lazyOverride > 0);
+
+  --fetchDepth_;
+
+  nodeSection(node).fetching = false;
+
+  updateState(node, oldState);
+
+  if (journaled)
+    rewriteLazyUndo(node, initStates);
+
+  if (snapshotsEnabled_ && ! isBulkUpdate())
+    publishSnapshot();
+}
+
+int
+CQCheckTreeModel::
+addCheckPath(const QString &path)
+{
+  int pos = path.lastIndexOf(hierSep());
+
+  int parent = (pos > 0 ? pathSection(path.left(pos)) : ROOT_NODE);
+
+  return addCheck(parent, path.mid(pos + 1));
+}
+
+void
+CQCheckTreeModel::
+addCheckPaths(const QStringList &paths)
+{
+  int numChars = 0;
+
+  for (const auto &path : paths)
+    numChars += path.size();
+
+  reserve(paths.size(), numChars);
+
+  // consecutive paths usually share their section
+  QString lastPath;
+  int     lastSection = -1;
+
+  auto pathParent = [&](const QString &path, int pos) {
+    if (pos <= 0)
+      return int(ROOT_NODE);
+
+    if (lastSection < 0 || path.leftRef(pos) != lastPath) {
+      lastPath    = path.left(pos);
+      lastSection = pathSection(lastPath);
+    }
+
+    return lastSection;
+  };
+
+  // empty model is populated in a single reset
+  if (nodeSection(ROOT_NODE).children.empty()) {
+    beginBulkUpdate();
+
+    for (const auto &path : paths) {
+      int pos = path.lastIndexOf(hierSep());
+
+      addCheck(pathParent(path, pos), path.mid(pos + 1));
+    }
+
+    endBulkUpdate();
+
+    return;
+  }
+
+  // otherwise a reset would lose the view's expansion, scroll and hidden rows
+  // so missing sections are added first, then the checks of each parent in a
+  // single row insert
+  std::vector<std::pair<int, QStringList>> parentChecks;
+  QHash<int, int>                          parentInds; // parent node -> parentChecks index
+
+  for (const auto &path : paths) {
+    int pos = path.lastIndexOf(hierSep());
+
+    int parent = pathParent(path, pos);
+
+    auto p = parentInds.find(parent);
+
+    if (p == parentInds.end()) {
+      p = parentInds.insert(parent, int(parentChecks.size()));
+
+      parentChecks.push_back(std::make_pair(parent, QStringList()));
+    }
+
+    parentChecks[size_t(p.value())].second << path.mid(pos + 1);
+  }
+
+  for (const auto &pc : parentChecks)
+    (void) addChecks(pc.first, pc.second);
+}
+
+int
+CQCheckTreeModel::
+pathSection(const QString &path)
+{
+  if (path.isEmpty())
+    return ROOT_NODE;
+
+  // index existing sections
+  if (! pathSectionsValid_) {
+    pathSections_.clear();
+
+    for (int node = ROOT_NODE + 1; node < numNodes(); ++node) {
+      if (! isValidNode(node) || ! isSection(node))
+        continue;
+
+      auto path1 = sectionHierName(node);
+
+      if (! pathSections_.contains(path1))
+        pathSections_[path1] = node;
+    }
+
+    pathSectionsValid_ = true;
+  }
+
+  auto p = pathSections_.find(path);
+
+  if (p != pathSections_.end())
+    return p.value();
+
+  // add missing section to parent path section (added to map by addNode)
+  int pos = path.lastIndexOf(hierSep());
+
+  int parent = (pos > 0 ? pathSection(path.left(pos)) : ROOT_NODE);
+
+  int node = addSection(parent, path.mid(pos + 1));
+
+  // path may differ from hier name of new section (leading separator)
+  pathSections_[path] = node;
+
+  return node;
+}
+
+bool
+CQCheckTreeModel::
+removeCheck(int node)
+{
+  if (! isValidNode(node) || isSection(node))
+    return false;
+
+  return removeRange(parentNode(node), nodeRow(node), 1);
+}
+
+bool
+CQCheckTreeModel::
+removeSection(int node)
+{
+  if (node == ROOT_NODE || ! isValidNode(node) || ! isSection(node))
+    return false;
+
+  return removeRange(parentNode(node), nodeRow(node), 1);
+}
+
+bool
+CQCheckTreeModel::
+removeRange(int parent, int row, int count)
+{
+  if (! isValidNode(parent) || ! isSection(parent) || isLazy(parent))
+    return false;
+
+  if (row < 0 || count <= 0 || row + count > int(nodeSection(parent).children.size()))
+    return false;
+
+  removeChildren(parent, row, count);
+
+  return true;
+}
+
+void
+CQCheckTreeModel::
+removeChildren(int parent, int row, int count)
+{
+  assert(! isCheckChange());
+
+  auto oldState = checkState(parent);
+
+  bool notify = ! isBulkUpdate();
+
+  if (notify)
+    beginRemoveRows(nodeModelIndex(parent), row, row + count - 1);
+
+  auto &section = nodeSection(parent);
+
+  // removed rows are contiguous so their sections and checks are contiguous
+  // ranges of the parent's section and check lists
+  int sectionInd = -1, numSections = 0;
+  int checkInd   = -1, numChecks   = 0;
+
+  int oldNumChecks = int(section.checks.size());
+
+  std::vector<int> removed;
+
+  for (int i = row; i < row + count; ++i) {
+    int node = section.children[size_t(i)];
+
+    if (isSection(node)) {
+      if (sectionInd < 0)
+        sectionInd = nodeInd(node);
+
+      ++numSections;
+
+      // remove child state from parent counts
+      auto state = checkState(node);
+
+      if      (state == Qt::Checked)
+        --section.numSectionsChecked;
+      else if (state == Qt::PartiallyChecked)
+        --section.numSectionsPartial;
+    }
+    else {
+      if (checkInd < 0)
+        checkInd = nodeInd(node);
+
+      ++numChecks;
+
+      if (section.checkBits.test(nodeInd(node)))
+        --section.numChecked;
+    }
+
+    removeSubtree(node, removed);
+  }
+
+  // compact child lists and update rows and indices of later siblings
+  section.children.erase(section.children.begin() + row,
+                         section.children.begin() + row + count);
+
+  for (size_t i = size_t(row); i < section.children.size(); ++i)
+    nodes_[size_t(section.children[i])].row = int(i);
+
+  if (numSections > 0) {
+    section.sections.erase(section.sections.begin() + sectionInd,
+                           section.sections.begin() + sectionInd + numSections);
+
+    for (size_t i = size_t(sectionInd); i < section.sections.size(); ++i) {
+      nodes_[size_t(section.sections[i])].ind = int(i);
+
+      markStructureNode(section.sections[i]);
+    }
+  }
+
+  if (numChecks > 0) {
+    section.checks.erase(section.checks.begin() + checkInd,
+                         section.checks.begin() + checkInd + numChecks);
+
+    section.checkBits.erase(checkInd, numChecks);
+
+    for (size_t i = size_t(checkInd); i < section.checks.size(); ++i) {
+      nodes_[size_t(section.checks[i])].ind = int(i);
+
+      markStructureNode(section.checks[i]);
+    }
+  }
+
+  // journal check indices follow compacted checks
+  if (canUndo() || canRedo()) {
+    std::vector<int> checkInds;
+
+    if (numChecks > 0) {
+      checkInds.resize(size_t(oldNumChecks));
+
+      for (int i = 0; i < oldNumChecks; ++i) {
+        if      (i < checkInd)
+          checkInds[size_t(i)] = i;
+        else if (i < checkInd + numChecks)
+          checkInds[size_t(i)] = -1;
+        else
+          checkInds[size_t(i)] = i - numChecks;
+      }
+    }
+
+    std::sort(removed.begin(), removed.end());
+
+    remapUndo(parent, checkInds, removed);
+  }
+
+  if (searchIndexed_) {
+    for (auto node : removed) {
+      const auto &n = nodes_[size_t(node)];
+
+      searchIndex_.removeLabel(node, labels_.constData() + n.labelOffset, int(n.labelLength));
+    }
+
+    searchIndex_.flushRemoved();
+  }
+
+  markStructureSection(parent);
+
+  pathSections_.clear();
+
+  pathSectionsValid_ = false;
+
+  if (notify)
+    endRemoveRows();
+
+  // ids and section indices are reused by later adds (views have dropped rows)
+  for (auto node : removed) {
+    const auto &n = nodes_[size_t(node)];
+
+    removedChars_ += int(n.labelLength);
+
+    if (n.isSection)
+      freeSections_.push_back(n.section);
+
+    freeNodes_.push_back(node);
+  }
+
+  if (removedChars_ >= COMPACT_LABEL_CHARS && removedChars_ > labels_.size()/2)
+    compactLabels();
+
+  updateState(parent, oldState);
+
+  schedulePublish();
+}
+
+void
+CQCheckTreeModel::
+removeSubtree(int node, std::vector<int> &removed)
+{
+  auto &n = nodes_[size_t(node)];
+
+  n.removed = 1;
+
+  removed.push_back(node);
+
+  markStructureNode(node);
+
+  if (! n.isSection)
+    return;
+
+  auto &section = sections_[size_t(n.section)];
+
+  for (auto child : section.children)
+    removeSubtree(child, removed);
+
+  // child storage is kept for the section which reuses the index
+  section.recycle();
+}
+
+void
+CQCheckTreeModel::
+compactLabels()
+{
+  // copy labels of live nodes to new buffer (in node order)
+  QString labels;
+
+  labels.reserve(labels_.size() - removedChars_);
+
+  for (auto &n : nodes_) {
+    if (n.removed) {
+      n.labelOffset = 0;
+      n.labelLength = 0;
+
+      continue;
+    }
+
+    uint offset = uint(labels.size());
+
+    labels.append(labels_.constData() + n.labelOffset, int(n.labelLength));
+
+    n.labelOffset = offset;
+  }
+
+  std::swap(labels_, labels);
+
+  removedChars_ = 0;
+
+  // all label offsets changed
+  resetStructure();
+}
+
+bool
+CQCheckTreeModel::
+moveRow(int parent, int row, int newRow)
+{
+  if (! isValidNode(parent) || ! isSection(parent))
+    return false;
+
+  auto &section = nodeSection(parent);
+
+  int n = int(section.children.size());
+
+  if (row < 0 || row >= n || newRow < 0 || newRow >= n)
+    return false;
+
+  if (row == newRow)
+    return true;
+
+  bool notify = ! isBulkUpdate();
+
+  if (notify) {
+    auto parentInd = nodeModelIndex(parent);
+
+    // destination is row before which moved row is inserted
+    (void) beginMoveRows(parentInd, row, row, parentInd, newRow > row ? newRow + 1 : newRow);
+  }
+
+  auto &children = section.children;
+
+  int node = children[size_t(row)];
+
+  children.erase (children.begin() + row);
+  children.insert(children.begin() + newRow, node);
+
+  for (int i = std::min(row, newRow); i <= std::max(row, newRow); ++i)
+    nodes_[size_t(children[size_t(i)])].row = i;
+
+  updateChildLists(parent);
+
+  if (notify)
+    endMoveRows();
+
+  schedulePublish();
+
+  return true;
+}
+
+void
+CQCheckTreeModel::
+reorderChildren(const Reorders &reorders)
+{
+  if (reorders.empty())
+    return;
+
+  // single layout change for all moved rows (persistent indices of rows, and
+  // so the view's expansion and hidden state, follow their nodes)
+  bool notify = ! isBulkUpdate();
+
+  // changed parents (empty for all if top level rows move)
+  QList<QPersistentModelIndex> parents;
+
+  for (const auto &reorder : reorders) {
+    if (reorder.first == ROOT_NODE) {
+      parents.clear();
+      break;
+    }
+
+    parents << nodeModelIndex(reorder.first);
+  }
+
+  if (notify)
+    Q_EMIT layoutAboutToBeChanged(parents, QAbstractItemModel::VerticalSortHint);
+
+  for (const auto &reorder : reorders) {
+    int         parent   = reorder.first;
+    const auto &children = reorder.second;
+
+    auto &section = nodeSection(parent);
+
+    assert(children.size() == section.children.size());
+
+    section.children = children;
+
+    for (size_t i = 0; i < children.size(); ++i)
+      nodes_[size_t(children[i])].row = int(i);
+
+    updateChildLists(parent);
+  }
+
+  if (notify) {
+    // one pass over persistent indices (only rows of reordered parents differ)
+    for (const auto &ind : persistentIndexList()) {
+      int node = modelIndexNode(ind);
+
+      if (node != ROOT_NODE && ind.row() != nodeRow(node))
+        changePersistentIndex(ind, createIndex(nodeRow(node), ind.column(), quintptr(node)));
+    }
+
+    Q_EMIT layoutChanged(parents, QAbstractItemModel::VerticalSortHint);
+  }
+
+  schedulePublish();
+}
+
+void
+CQCheckTreeModel::
+updateChildLists(int parent)
+{
+  auto &section = nodeSection(parent);
+
+  const auto &children = section.children;
+
+  // section and check lists (and check bits) stay in row order
+  CQCheckTreeBits checkBits;
+
+  checkBits.resize(section.checkBits.size());
+
+  // old -> new check index (for journal)
+  bool journal = (canUndo() || canRedo());
+
+  std::vector<int> checkInds;
+
+  if (journal)
+    checkInds.resize(section.checks.size(), -1);
+
+  section.sections.clear();
+  section.checks  .clear();
+
+  for (auto child : children) {
+    auto &n = nodes_[size_t(child)];
+
+    int ind = n.ind;
+
+    if (n.isSection) {
+      n.ind = int(section.sections.size());
+
+      section.sections.push_back(child);
+    }
+    else {
+      checkBits.set(int(section.checks.size()), section.checkBits.test(n.ind));
+
+      n.ind = int(section.checks.size());
+
+      if (journal)
+        checkInds[size_t(ind)] = n.ind;
+
+      section.checks.push_back(child);
+    }
+
+    if (n.ind != ind)
+      markStructureNode(child);
+  }
+
+  section.checkBits = checkBits;
+
+  if (journal)
+    remapUndo(parent, checkInds, std::vector<int>());
+
+  markSnapshotDirty(parent);
+
+  markStructureSection(parent);
+}
+
+//---
+
+// wanted children of section (from setContents paths)
+struct CQCheckTreeModel::ContentsSection {
+  struct Child {
+    QString label;
+    bool    isSection { false };
+    int     section   { -1 }; // contents section of child section
+  };
+
+  std::vector<Child>  children;
+  QHash<QString, int> sectionInds; // label -> child section contents section
+};
+
+void
+CQCheckTreeModel::
+setContents(const QStringList &paths)
+{
+  // build wanted tree (children in order of first appearance)
+  ContentsSections sections(1);
+
+  for (const auto &path : paths) {
+    QStringList parts;
+
+    for (const auto &part : path.split(hierSep()))
+      if (! part.isEmpty())
+        parts << part;
+
+    if (parts.isEmpty())
+      continue;
+
+    int ind = 0;
+
+    for (int i = 0; i < parts.size() - 1; ++i) {
+      auto p = sections[size_t(ind)].sectionInds.find(parts[i]);
+
+      if (p != sections[size_t(ind)].sectionInds.end()) {
+        ind = p.value();
+        continue;
+      }
+
+      int ind1 = int(sections.size());
+
+      sections.push_back(ContentsSection());
+
+      ContentsSection::Child child;
+
+      child.label     = parts[i];
+      child.isSection = true;
+      child.section   = ind1;
+
+      sections[size_t(ind)].children.push_back(child);
+      sections[size_t(ind)].sectionInds[parts[i]] = ind1;
+
+      ind = ind1;
+    }
+
+    ContentsSection::Child child;
+
+    child.label = parts.last();
+
+    sections[size_t(ind)].children.push_back(child);
+  }
+
+  // out of order children of all sections are moved together at end (rows
+  // seen by views are unchanged while children are added and removed)
+  Reorders reorders;
+
+  (void) reconcileSection(ROOT_NODE, sections, 0, reorders);
+
+  reorderChildren(reorders);
+}
+
+bool
+CQCheckTreeModel::
+reconcileSection(int node, const ContentsSections &sections, int ind, Reorders &reorders)
+{
+  const auto &contents = sections[size_t(ind)];
+
+  int nw = int(contents.children.size());
+
+  // unfetched section (label matched by parent) is kept if its child count
+  // matches so a refresh does not fetch the provider's tree
+  if (isLazy(node)) {
+    if (nodeSection(node).lazyChildren == nw)
+      return false;
+
+    fetchNode(node);
+  }
+
+  // unchanged if children have wanted types and labels in order (compared in
+  // place so refresh of unchanged tree builds no keys)
+  bool changed = false;
+
+  std::vector<int> wantNodes; // child nodes in wanted order
+
+  {
+  const auto &children = nodeSection(node).children;
+
+  changed = (int(children.size()) != nw);
+
+  for (int i = 0; ! changed && i < nw; ++i) {
+    const auto &child = contents.children[size_t(i)];
+
+    const auto &n = nodes_[size_t(children[size_t(i)])];
+
+    changed = (bool(n.isSection) != child.isSection ||
+               labels_.midRef(int(n.labelOffset), int(n.labelLength)) != child.label);
+  }
+  }
+
+  if (changed) {
+    // children are keyed by type, label and occurrence of label
+    auto childKey = [&](bool isSection, const QString &label, QHash<QString, int> &counts) {
+      auto key = (isSection ? QString("s") : QString("c")) + label;
+
+      return key + KEY_SEP + QString::number(counts[key]++);
+    };
+
+    QHash<QString, int> wantInds;
+
+    {
+    QHash<QString, int> counts;
+
+    for (int i = 0; i < nw; ++i) {
+      const auto &child = contents.children[size_t(i)];
+
+      wantInds[childKey(child.isSection, child.label, counts)] = i;
+    }
+    }
+
+    QStringList keys;
+
+    {
+    QHash<QString, int> counts;
+
+    for (auto child : nodeSection(node).children)
+      keys << childKey(isSection(child), nodeText(child), counts);
+    }
+
+    // remove unwanted children (contiguous rows in one remove, last first)
+    int row = keys.size() - 1;
+
+    while (row >= 0) {
+      if (wantInds.contains(keys[row])) {
+        --row;
+        continue;
+      }
+
+      int row1 = row;
+
+      while (row1 > 0 && ! wantInds.contains(keys[row1 - 1]))
+        --row1;
+
+      removeChildren(node, row1, row - row1 + 1);
+
+      keys.erase(keys.begin() + row1, keys.begin() + row + 1);
+
+      row = row1 - 1;
+    }
+
+    // wanted child nodes (existing or appended)
+    wantNodes.assign(size_t(nw), -1);
+
+    {
+    const auto &children = nodeSection(node).children;
+
+    for (int i = 0; i < keys.size(); ++i)
+      wantNodes[size_t(wantInds[keys[i]])] = children[size_t(i)];
+    }
+
+    int i = 0;
+
+    while (i < nw) {
+      if (wantNodes[size_t(i)] >= 0) {
+        ++i;
+        continue;
+      }
+
+      const auto &child = contents.children[size_t(i)];
+
+      if (child.isSection) {
+        wantNodes[size_t(i)] = addSection(node, child.label);
+
+        ++i;
+
+        continue;
+      }
+
+      // consecutive missing checks are added together
+      QStringList labels;
+
+      int i1 = i;
+
+      while (i < nw && wantNodes[size_t(i)] < 0 && ! contents.children[size_t(i)].isSection)
+        labels << contents.children[size_t(i++)].label;
+
+      (void) addChecks(node, labels);
+
+      // new checks are last children (ids need not be consecutive)
+      const auto &children = nodeSection(node).children;
+
+      int row1 = int(children.size()) - labels.size();
+
+      for (int j = i1; j < i; ++j)
+        wantNodes[size_t(j)] = children[size_t(row1 + j - i1)];
+    }
+
+    // out of order children are moved after all sections are reconciled
+    if (nodeSection(node).children != wantNodes)
+      reorders.push_back(Reorder(node, wantNodes));
+  }
+  else
+    wantNodes = nodeSection(node).children;
+
+  // reconcile child sections (wanted order as children are not moved yet)
+  for (int j = 0; j < nw; ++j) {
+    const auto &child = contents.children[size_t(j)];
+
+    if (child.isSection &&
+        reconcileSection(wantNodes[size_t(j)], sections, child.section, reorders))
+      changed = true;
+  }
+
+  return changed;
+}
+
+QString
+CQCheckTreeModel::
+nodeText(int node) const
+{
+  const auto &n = nodes_[size_t(node)];
+
+  return labels_.mid(int(n.labelOffset), int(n.labelLength));
+}
+
+QString
+CQCheckTreeModel::
+hierName(int node) const
+{
+  if (isSection(node))
+    return sectionHierName(node);
+
+  QString str;
+
+  appendHierName(node, str);
+
+  return str;
+}
+
+void
+CQCheckTreeModel::
+appendHierName(int node, QString &str) const
+{
+  const auto &n = nodes_[size_t(node)];
+
+  if (n.parent > ROOT_NODE) {
+    str += sectionHierName(n.parent);
+    str += hierSep();
+  }
+
+  str.append(labels_.constData() + n.labelOffset, int(n.labelLength));
+}
+
+const QString &
+CQCheckTreeModel::
+sectionHierName(int node) const
+{
+  const auto &section = nodeSection(node);
+
+  if (section.hierGen != hierGen_) {
+    section.hierName.clear();
+
+    appendHierName(node, section.hierName);
+
+    section.hierGen = hierGen_;
+  }
+
+  return section.hierName;
+}
+
+int
+CQCheckTreeModel::
+numSections(int node) const
+{
+  return int(nodeSection(node).sections.size());
+}
+
+int
+CQCheckTreeModel::
+numChecks(int node) const
+{
+  return int(nodeSection(node).checks.size());
+}
+
+int
+CQCheckTreeModel::
+sectionNode(int node, int i) const
+{
+  const auto &section = nodeSection(node);
+
+  if (i < 0 || i >= int(section.sections.size()))
+    return -1;
+
+  return section.sections[size_t(i)];
+}
+
+int
+CQCheckTreeModel::
+checkNode(int node, int i) const
+{
+  const auto &section = nodeSection(node);
+
+  if (i < 0 || i >= int(section.checks.size()))
+    return -1;
+
+  return section.checks[size_t(i)];
+}
+
+const CQCheckTreeModel::Section &
+CQCheckTreeModel::
+nodeSection(int node) const
+{
+  const auto &n = nodes_[size_t(node)];
+  assert(n.isSection);
+
+  return sections_[size_t(n.section)];
+}
+
+CQCheckTreeModel::Section &
+CQCheckTreeModel::
+nodeSection(int node)
+{
+  const auto &n = nodes_[size_t(node)];
+  assert(n.isSection);
+
+  return sections_[size_t(n.section)];
+}
+
+//---
+
+bool
+CQCheckTreeModel::
+isChecked(int node) const
+{
+  if (! isValidNode(node))
+    return false;
+
+  const auto &n = nodes_[size_t(node)];
+
+  if (n.isSection)
+    return (checkState(node) == Qt::Checked);
+
+  return nodeSection(n.parent).checkBits.test(n.ind);
+}
+
+Qt::CheckState
+CQCheckTreeModel::
+checkState(int node) const
+{
+  CQCheckTreeStatsTimer timer(stats_ ? &stats_->checkState : nullptr);
+
+  const auto &n = nodes_[size_t(node)];
+
+  if (! n.isSection)
+    return (nodeSection(n.parent).checkBits.test(n.ind) ? Qt::Checked : Qt::Unchecked);
+
+  // child counts are maintained incrementally (see checkChanged/childStateChanged)
+  const auto &section = sections_[size_t(n.section)];
+
+  // unfetched section uses aggregate counts of its subtree
+  if (section.lazy) {
+    if      (section.lazyChecked == 0)
+      return Qt::Unchecked;
+    else if (section.lazyChecked == section.lazyTotal)
+      return Qt::Checked;
+    else
+      return Qt::PartiallyChecked;
+  }
+
+  if (section.numSectionsPartial > 0)
+    return Qt::PartiallyChecked;
+
+  if      (section.numSectionsChecked == 0 && section.numChecked == 0)
+    return Qt::Unchecked;
+  else if (section.numSectionsChecked == section.sections.size() &&
+           section.numChecked         == section.checks  .size())
+    return Qt::Checked;
+  else
+    return Qt::PartiallyChecked;
+}
+
+void
+CQCheckTreeModel::
+setChecked(int node, bool checked)
+{
+  if (! isValidNode(node))
+    return;
+
+  if (! isSection(node)) {
+    setCheckChecked(node, checked);
+    return;
+  }
+
+  // no signals are sent until the change ends so child lists are stable
+  beginCheckChange();
+
+  const auto &section = nodeSection(node);
+
+  if (! section.lazy) {
+    for (auto section1 : section.sections)
+      setChecked(section1, checked);
+
+    setSectionChecks(node, checked);
+  }
+  else
+    setLazyChecked(node, checked);
+
+  endCheckChange();
+}
+
+void
+CQCheckTreeModel::
+setSectionChecks(int node, bool checked)
+{
+  assert(isCheckChange());
+
+  auto oldState = checkState(node);
+
+  auto &section = nodeSection(node);
+
+  // record changed checks (differing bits) then set all bits
+  section.checkBits.forEachDiff(checked, [&](int i) {
+    addChangedNode(section.checks[size_t(i)], ! checked);
+  });
+
+  section.checkBits.fill(checked);
+
+  section.numChecked = (checked ? uint(section.checks.size()) : 0);
+
+  updateState(node, oldState);
+}
+
+void
+CQCheckTreeModel::
+setLazyChecked(int node, bool checked)
+{
+  // no check nodes exist yet so record state to apply when fetched
+  auto oldState = checkState(node);
+
+  journalLazy(node);
+
+  auto &section = nodeSection(node);
+
+  section.lazyChecked  = (checked ? section.lazyTotal : 0);
+  section.lazyOverride = (checked ? 1 : 0);
+
+  updateState(node, oldState);
+}
+
+void
+CQCheckTreeModel::
+resetLazyChecked(int node)
+{
+  // clear state set before fetch so provider's counts apply again
+  if (nodeSection(node).lazyOverride < 0)
+    return;
+
+  auto oldState = checkState(node);
+
+  journalLazy(node);
+
+  int numChecked = 0, numChecks = 0;
+
+  if (provider_)
+    provider_->checkCounts(this, node, numChecked, numChecks);
+
+  numChecks  = std::max(numChecks, 0);
+  numChecked = std::min(std::max(numChecked, 0), numChecks);
+
+  auto &section = nodeSection(node);
+
+  section.lazyChecked  = std::min(uint(numChecked), section.lazyTotal);
+  section.lazyOverride = -1;
+
+  updateState(node, oldState);
+}
+
+void
+CQCheckTreeModel::
+journalLazy(int node)
+{
+  // journal state before first change in change set
+  if (! isJournaling())
+    return;
+
+  auto p = std::find_if(undoLazy_.begin(), undoLazy_.end(),
+                        [&](const UndoLazy &l) { return l.node == node; });
+
+  if (p != undoLazy_.end())
+    return;
+
+  const auto &section = nodeSection(node);
+
+  UndoLazy lazy;
+
+  lazy.node         = node;
+  lazy.lazyOverride = section.lazyOverride;
+  lazy.lazyChecked  = section.lazyChecked;
+
+  undoLazy_.push_back(lazy);
+}
+
+void
+CQCheckTreeModel::
+setNodesChecked(const std::vector<int> &nodes, bool checked)
+{
+  beginCheckChange();
+
+  for (auto node : nodes)
+    setChecked(node, checked);
+
+  endCheckChange();
+}
+
+void
+CQCheckTreeModel::
+setCheckChecked(int node, bool checked)
+{
+  const auto &n = nodes_[size_t(node)];
+
+  int parent = n.parent;
+
+  auto &bits = nodeSection(parent).checkBits;
+
+  if (bits.test(n.ind) == checked)
+    return;
+
+  bits.set(n.ind, checked);
+
+  bool pending = isCheckChange();
+
+  if (pending)
+    addChangedNode(node, ! checked);
+  else
+    emitNodeChanged(node);
+
+  checkChanged(parent, checked);
+
+  if (! pending && isJournaling()) {
+    CheckInds checkInds;
+
+    checkInds.push_back(CheckInds::value_type(parent, nodeInd(node)));
+
+    addUndoEntry(checkInds);
+  }
+
+  if (! pending && ! isFetching()) {
+    if (snapshotsEnabled_ && ! isBulkUpdate())
+      publishSnapshot();
+
+    Q_EMIT nodeChecked(node, checked);
+  }
+}
+
+void
+CQCheckTreeModel::
+addChangedNode(int node, bool wasChecked)
+{
+  auto &n = nodes_[size_t(node)];
+
+  if (! n.changed) {
+    n.changed    = 1;
+    n.wasChecked = wasChecked;
+
+    changedNodes_.push_back(node);
+  }
+
+  emitNodeChanged(node);
+}
+
+void
+CQCheckTreeModel::
+beginCheckChange()
+{
+  ++changeDepth_;
+}
+
+void
+CQCheckTreeModel::
+endCheckChange()
+{
+  assert(changeDepth_ > 0);
+
+  if (--changeDepth_ == 0)
+    flushCheckChange();
+}
+
+void
+CQCheckTreeModel::
+flushCheckChange()
+{
+  // one data changed range per parent
+  DirtyRows dirtyRows;
+
+  std::swap(dirtyRows, dirtyRows_);
+
+  if (! isBulkUpdate()) {
+    for (const auto &pr : dirtyRows) {
+      const auto &section = nodeSection(pr.first);
+
+      int row1 = pr.second.first;
+      int row2 = pr.second.second;
+
+      auto ind1 = createIndex(row1, CHECK_COLUMN, quintptr(section.children[size_t(row1)]));
+      auto ind2 = createIndex(row2, CHECK_COLUMN, quintptr(section.children[size_t(row2)]));
+
+      CQCheckTreeStatsTimer timer(stats_ ? &stats_->dataChanged : nullptr);
+
+      Q_EMIT dataChanged(ind1, ind2);
+    }
+  }
+
+  //---
+
+  // single change set signal per final check state (ignore checks changed back)
+  QVector<int> checkedNodes, uncheckedNodes;
+
+  bool journal = isJournaling();
+
+  CheckInds checkInds;
+
+  for (auto node : changedNodes_) {
+    auto &n = nodes_[size_t(node)];
+
+    n.changed = 0;
+
+    bool checked = isChecked(node);
+
+    if (checked == bool(n.wasChecked))
+      continue;
+
+    if (checked)
+      checkedNodes.push_back(node);
+    else
+      uncheckedNodes.push_back(node);
+
+    if (journal)
+      checkInds.push_back(CheckInds::value_type(n.parent, n.ind));
+  }
+
+  changedNodes_.clear();
+
+  if (journal)
+    addUndoEntry(checkInds);
+
+  undoLazy_.clear();
+
+  // initial state of fetched children is not a change
+  if (isFetching())
+    return;
+
+  // readers see new state before change signals
+  if (snapshotsEnabled_ && ! isBulkUpdate())
+    publishSnapshot();
+
+  if (! checkedNodes.isEmpty())
+    Q_EMIT nodesChecked(checkedNodes, true);
+
+  if (! uncheckedNodes.isEmpty())
+    Q_EMIT nodesChecked(uncheckedNodes, false);
+}
+
+void
+CQCheckTreeModel::
+checkChanged(int node, bool checked)
+{
+  auto oldState = checkState(node);
+
+  auto &section = nodeSection(node);
+
+  if (checked)
+    ++section.numChecked;
+  else {
+    assert(section.numChecked > 0);
+
+    --section.numChecked;
+  }
+
+  updateState(node, oldState);
+}
+
+void
+CQCheckTreeModel::
+childStateChanged(int node, Qt::CheckState oldState, Qt::CheckState newState)
+{
+  auto oldState1 = checkState(node);
+
+  auto &section = nodeSection(node);
+
+  if      (oldState == Qt::Checked)
+    --section.numSectionsChecked;
+  else if (oldState == Qt::PartiallyChecked)
+    --section.numSectionsPartial;
+
+  if      (newState == Qt::Checked)
+    ++section.numSectionsChecked;
+  else if (newState == Qt::PartiallyChecked)
+    ++section.numSectionsPartial;
+
+  updateState(node, oldState1);
+}
+
+void
+CQCheckTreeModel::
+updateState(int node, Qt::CheckState oldState)
+{
+  CQCheckTreeStatsTimer timer(stats_ ? &stats_->updateState : nullptr);
+
+  // bits or child counts of section changed
+  markSnapshotDirty(node);
+
+  // propagate state change to parent section (O(depth))
+  int parent = parentNode(node);
+
+  if (parent < 0)
+    return;
+
+  auto newState = checkState(node);
+
+  if (newState == oldState)
+    return;
+
+  emitNodeChanged(node);
+
+  // parent of fetching section is updated when fetch completes
+  if (isSection(node) && nodeSection(node).fetching)
+    return;
+
+  childStateChanged(parent, oldState, newState);
+}
+
+void
+CQCheckTreeModel::
+emitNodeChanged(int node)
+{
+  if (node <= ROOT_NODE || isBulkUpdate())
+    return;
+
+  // add to parent's changed row range
+  if (isCheckChange()) {
+    int parent = parentNode(node);
+    int row    = nodeRow(node);
+
+    auto p = dirtyRows_.find(parent);
+
+    if (p == dirtyRows_.end())
+      dirtyRows_[parent] = RowRange(row, row);
+    else {
+      auto &range = (*p).second;
+
+      range.first  = std::min(range.first , row);
+      range.second = std::max(range.second, row);
+    }
+
+    return;
+  }
+
+  auto ind = nodeModelIndex(node, CHECK_COLUMN);
+
+  CQCheckTreeStatsTimer timer(stats_ ? &stats_->dataChanged : nullptr);
+
+  Q_EMIT dataChanged(ind, ind);
+}
+
+//---
+
+bool
+CQCheckTreeModel::
+isJournaling() const
+{
+  // replayed changes and initial state of fetched children are not journaled
+  return (undoMemoryLimit_ > 0 && replayDepth_ == 0 && ! isFetching());
+}
+
+void
+CQCheckTreeModel::
+addUndoEntry(CheckInds &checkInds)
+{
+  if (checkInds.empty() && undoLazy_.empty())
+    return;
+
+  // run length encode flipped checks per section
+  std::sort(checkInds.begin(), checkInds.end());
+
+  UndoEntry entry;
+
+  for (const auto &checkInd : checkInds) {
+    if (! entry.runs.empty()) {
+      auto &run = entry.runs.back();
+
+      if (run.section == checkInd.first && run.start + run.length == checkInd.second) {
+        ++run.length;
+        continue;
+      }
+    }
+
+    UndoRun run;
+
+    run.section = checkInd.first;
+    run.start   = checkInd.second;
+    run.length  = 1;
+
+    entry.runs.push_back(run);
+  }
+
+  entry.runs.shrink_to_fit();
+
+  entry.lazy = undoLazy_;
+
+  pushUndo(std::move(entry));
+}
+
+void
+CQCheckTreeModel::
+pushUndo(UndoEntry &&entry)
+{
+  // new change discards redo steps
+  for (const auto &entry1 : redoStack_)
+    undoMemory_ -= entry1.memSize();
+
+  redoStack_.clear();
+
+  undoMemory_ += entry.memSize();
+
+  undoStack_.push_back(std::move(entry));
+
+  // discard oldest steps (keep most recent)
+  while (undoMemory_ > undoMemoryLimit_ && undoStack_.size() > 1) {
+    undoMemory_ -= undoStack_.front().memSize();
+
+    undoStack_.pop_front();
+  }
+
+  Q_EMIT undoChanged();
+}
+
+void
+CQCheckTreeModel::
+remapUndo(int node, const std::vector<int> &checkInds, const std::vector<int> &removed)
+{
+  auto isRemoved = [&](int node1) {
+    return std::binary_search(removed.begin(), removed.end(), node1);
+  };
+
+  auto isAffected = [&](const UndoEntry &entry) {
+    for (const auto &run : entry.runs)
+      if ((run.section == node && ! checkInds.empty()) || isRemoved(run.section))
+        return true;
+
+    for (const auto &lazy : entry.lazy)
+      if (isRemoved(lazy.node))
+        return true;
+
+    return false;
+  };
+
+  auto isEmpty = [](const UndoEntry &entry) {
+    return (entry.runs.empty() && entry.lazy.empty());
+  };
+
+  bool dropped = false;
+
+  auto remapStack = [&](UndoStack &stack) {
+    for (auto &entry : stack) {
+      if (! isAffected(entry))
+        continue;
+
+      undoMemory_ -= entry.memSize();
+
+      // keep runs of other sections and re-encode mapped checks of section
+      std::vector<UndoRun> runs;
+      std::vector<int>     inds;
+
+      for (const auto &run : entry.runs) {
+        if (isRemoved(run.section))
+          continue;
+
+        if (run.section != node || checkInds.empty()) {
+          runs.push_back(run);
+          continue;
+        }
+
+        for (int j = run.start; j < run.start + run.length; ++j) {
+          int ind = checkInds[size_t(j)];
+
+          if (ind >= 0)
+            inds.push_back(ind);
+        }
+      }
+
+      std::sort(inds.begin(), inds.end());
+
+      for (auto ind : inds) {
+        if (! runs.empty()) {
+          auto &run = runs.back();
+
+          if (run.section == node && run.start + run.length == ind) {
+            ++run.length;
+            continue;
+          }
+        }
+
+        UndoRun run;
+
+        run.section = node;
+        run.start   = ind;
+        run.length  = 1;
+
+        runs.push_back(run);
+      }
+
+      runs.shrink_to_fit();
+
+      entry.runs = std::move(runs);
+
+      entry.lazy.erase(std::remove_if(entry.lazy.begin(), entry.lazy.end(),
+                         [&](const UndoLazy &l) { return isRemoved(l.node); }), entry.lazy.end());
+
+      undoMemory_ += entry.memSize();
+    }
+
+    // steps which only changed removed checks are dropped
+    for (const auto &entry : stack) {
+      if (isEmpty(entry)) {
+        undoMemory_ -= entry.memSize();
+
+        dropped = true;
+      }
+    }
+
+    stack.erase(std::remove_if(stack.begin(), stack.end(), isEmpty), stack.end());
+  };
+
+  remapStack(undoStack_);
+  remapStack(redoStack_);
+
+  if (dropped)
+    Q_EMIT undoChanged();
+}
+
+void
+CQCheckTreeModel::
+undo()
+{
+  if (undoStack_.empty())
+    return;
+
+  auto entry = std::move(undoStack_.back());
+
+  undoStack_.pop_back();
+
+  applyUndo(entry);
+
+  redoStack_.push_back(std::move(entry));
+
+  Q_EMIT undoChanged();
+}
+
+void
+CQCheckTreeModel::
+redo()
+{
+  if (redoStack_.empty())
+    return;
+
+  auto entry = std::move(redoStack_.back());
+
+  redoStack_.pop_back();
+
+  applyUndo(entry);
+
+  undoStack_.push_back(std::move(entry));
+
+  Q_EMIT undoChanged();
+}
+
+void
+CQCheckTreeModel::
+applyUndo(UndoEntry &entry)
+{
+  // flips are their own inverse so undo and redo apply the same runs
+  ++replayDepth_;
+
+  beginCheckChange();
+
+  size_t i = 0;
+
+  while (i < entry.runs.size()) {
+    int node = entry.runs[i].section;
+
+    auto oldState = checkState(node);
+
+    auto &section = nodeSection(node);
+
+    for ( ; i < entry.runs.size() && entry.runs[i].section == node; ++i) {
+      const auto &run = entry.runs[i];
+
+      for (int j = run.start; j < run.start + run.length; ++j) {
+        bool checked = ! section.checkBits.test(j);
+
+        section.checkBits.set(j, checked);
+
+        if (checked)
+          ++section.numChecked;
+        else
+          --section.numChecked;
+
+        addChangedNode(section.checks[size_t(j)], ! checked);
+      }
+    }
+
+    updateState(node, oldState);
+  }
+
+  // swap lazy states (states of fetched sections are rewritten as runs)
+  for (auto &lazy : entry.lazy) {
+    if (! isLazy(lazy.node))
+      continue;
+
+    auto oldState = checkState(lazy.node);
+
+    auto &section = nodeSection(lazy.node);
+
+    std::swap(section.lazyOverride, lazy.lazyOverride);
+    std::swap(section.lazyChecked , lazy.lazyChecked );
+
+    updateState(lazy.node, oldState);
+  }
+
+  endCheckChange();
+
+  --replayDepth_;
+}
+
+bool
+CQCheckTreeModel::
+isLazyJournaled(int node) const
+{
+  auto hasNode = [&](const UndoStack &stack) {
+    for (const auto &entry : stack)
+      for (const auto &lazy : entry.lazy)
+        if (lazy.node == node)
+          return true;
+
+    return false;
+  };
+
+  return hasNode(undoStack_) || hasNode(redoStack_);
+}
+
+void
+CQCheckTreeModel::
+getSubtreeStates(int node, SubtreeStates &states) const
+{
+  const auto &section = nodeSection(node);
+
+  SubtreeState state;
+
+  state.node         = node;
+  state.bits         = section.checkBits;
+  state.lazy         = section.lazy;
+  state.lazyOverride = section.lazyOverride;
+  state.lazyChecked  = section.lazyChecked;
+  state.lazyTotal    = section.lazyTotal;
+
+  states.push_back(state);
+
+  for (auto section1 : section.sections)
+    getSubtreeStates(section1, states);
+}
+
+void
+CQCheckTreeModel::
+rewriteLazyUndo(int node, const SubtreeStates &initStates)
+{
+  // a journaled lazy state is the section's state on the other side of its
+  // step (all checks set, or the provider's initial state if none was set).
+  // Subtree states between steps are rebuilt from the current state by
+  // walking each stack from its current end (newest undo step, next redo
+  // step) and each step's lazy state becomes runs of the checks it flips
+  // (and lazy states of unfetched child sections).
+  SubtreeStates curStates;
+
+  getSubtreeStates(node, curStates);
+
+  auto isEmpty = [](const UndoEntry &entry) {
+    return (entry.runs.empty() && entry.lazy.empty());
+  };
+
+  auto rewriteStack = [&](UndoStack &stack) {
+    auto states = curStates;
+
+    for (auto p = stack.rbegin(); p != stack.rend(); ++p) {
+      auto &entry = *p;
+
+      auto pl = std::find_if(entry.lazy.begin(), entry.lazy.end(),
+                             [&](const UndoLazy &l) { return l.node == node; });
+
+      if (pl == entry.lazy.end())
+        continue;
+
+      undoMemory_ -= entry.memSize();
+
+      int lazyOverride = (*pl).lazyOverride;
+
+      entry.lazy.erase(pl);
+
+      for (size_t i = 0; i < states.size(); ++i) {
+        auto &state = states[i];
+
+        auto target = initStates[i];
+
+        if (lazyOverride >= 0) {
+          bool checked = (lazyOverride > 0);
+
+          target.bits.fill(checked);
+
+          if (target.lazy) {
+            target.lazyOverride = lazyOverride;
+            target.lazyChecked  = (checked ? target.lazyTotal : 0);
+          }
+        }
+
+        if (state.lazy) {
+          if (state.lazyOverride != target.lazyOverride ||
+              state.lazyChecked  != target.lazyChecked) {
+            UndoLazy lazy;
+
+            lazy.node         = state.node;
+            lazy.lazyOverride = target.lazyOverride;
+            lazy.lazyChecked  = target.lazyChecked;
+
+            entry.lazy.push_back(lazy);
+          }
+        }
+        else {
+          state.bits.forEachDiff(target.bits, [&](int j) {
+            if (! entry.runs.empty()) {
+              auto &run = entry.runs.back();
+
+              if (run.section == state.node && run.start + run.length == j) {
+                ++run.length;
+                return;
+              }
+            }
+
+            UndoRun run;
+
+            run.section = state.node;
+            run.start   = j;
+            run.length  = 1;
+
+            entry.runs.push_back(run);
+          });
+        }
+
+        state = std::move(target);
+      }
+
+      undoMemory_ += entry.memSize();
+    }
+
+    // steps which left the subtree unchanged (and changed nothing else) are dropped
+    for (const auto &entry : stack)
+      if (isEmpty(entry))
+        undoMemory_ -= entry.memSize();
+
+    stack.erase(std::remove_if(stack.begin(), stack.end(), isEmpty), stack.end());
+  };
+
+  rewriteStack(undoStack_);
+  rewriteStack(redoStack_);
+
+  Q_EMIT undoChanged();
+}
+
+void
+CQCheckTreeModel::
+clearUndo()
+{
+  undoStack_.clear();
+  redoStack_.clear();
+
+  undoMemory_ = 0;
+
+  Q_EMIT undoChanged();
+}
+
+void
+CQCheckTreeModel::
+setUndoMemoryLimit(size_t bytes)
+{
+  undoMemoryLimit_ = bytes;
+
+  if (undoMemoryLimit_ == 0) {
+    clearUndo();
+    return;
+  }
+
+  while (undoMemory_ > undoMemoryLimit_ && ! undoStack_.empty()) {
+    undoMemory_ -= undoStack_.front().memSize();
+
+    undoStack_.pop_front();
+  }
+
+  Q_EMIT undoChanged();
+}
+
+//---
+
+int
+CQCheckTreeModel::
+treeIndexNode(const CQCheckTreeIndex &ind) const
+{
+  const auto &root = nodeSection(ROOT_NODE);
+
+  // top level check
+  if (ind.sectionInd < 0 || ind.sectionInd >= int(root.sections.size())) {
+    if (ind.itemInd >= 0 && ind.itemInd < int(root.checks.size()))
+      return root.checks[size_t(ind.itemInd)];
+
+    return -1;
+  }
+
+  int node = root.sections[size_t(ind.sectionInd)];
+
+  // sub sections
+  int depth = ind.depth();
+
+  for (int level = 1; level < depth; ++level) {
+    node = sectionNode(node, ind.sectionPathInd(level));
+
+    if (node < 0)
+      return -1;
+  }
+
+  // section or section check
+  if (ind.itemInd < 0)
+    return node;
+
+  return checkNode(node, ind.itemInd);
+}
+
+int
+CQCheckTreeModel::
+sectionIndexNode(const CQCheckTreeIndex &ind) const
+{
+  if (ind.sectionInd < 0)
+    return ROOT_NODE;
+
+  return treeIndexNode(ind.sectionIndex());
+}
+
+CQCheckTreeIndex
+CQCheckTreeModel::
+treeIndex(int node) const
+{
+  CQCheckTreeIndex ind;
+
+  if (! isValidNode(node) || node == ROOT_NODE)
+    return ind;
+
+  // check index in parent section
+  int section = node;
+
+  if (! isSection(node)) {
+    ind.itemInd = nodeInd(node);
+
+    section = parentNode(node);
+  }
+
+  // section path (innermost section last)
+  int depth = nodeDepth(section);
+
+  ind.setDepth(depth);
+
+  for (int level = depth - 1; level >= 0; --level) {
+    ind.setSectionPathInd(level, nodeInd(section));
+
+    section = parentNode(section);
+  }
+
+  return ind;
+}
+
+int
+CQCheckTreeModel::
+nodeDepth(int node) const
+{
+  int depth = 0;
+
+  while (node > ROOT_NODE) {
+    ++depth;
+
+    node = parentNode(node);
+  }
+
+  return depth;
+}
+
+//---
+
+CQCheckTreeModel::Items
+CQCheckTreeModel::
+getAllItems() const
+{
+  Items items;
+
+  for (const auto &item : this->items())
+    items.push_back(item);
+
+  return items;
+}
+
+CQCheckTreeModel::Items
+CQCheckTreeModel::
+getCheckedItems() const
+{
+  Items items;
+
+  for (const auto &item : checkedItems())
+    items.push_back(item);
+
+  return items;
+}
+
+CQCheckTreeItemRange
+CQCheckTreeModel::
+items() const
+{
+  return CQCheckTreeItemRange(CQCheckTreeItemIterator(this, firstItemNode(false), false));
+}
+
+CQCheckTreeItemRange
+CQCheckTreeModel::
+checkedItems() const
+{
+  return CQCheckTreeItemRange(CQCheckTreeItemIterator(this, firstItemNode(true), true));
+}
+
+int
+CQCheckTreeModel::
+firstItemNode(bool checked) const
+{
+  int node = stepItemNode(ROOT_NODE, checked);
+
+  while (node >= 0 && ! isIterItem(node, checked))
+    node = stepItemNode(node, checked);
+
+  return node;
+}
+
+int
+CQCheckTreeModel::
+nextItemNode(int node, bool checked) const
+{
+  do {
+    node = stepItemNode(node, checked);
+  } while (node >= 0 && ! isIterItem(node, checked));
+
+  return node;
+}
+
+bool
+CQCheckTreeModel::
+isIterItem(int node, bool checked) const
+{
+  // checks reached when iterating checked items are always checked
+  if (! checked || ! isSection(node))
+    return true;
+
+  return (checkState(node) == Qt::Checked);
+}
+
+int
+CQCheckTreeModel::
+stepItemNode(int node, bool checked) const
+{
+  // pre-order: section, its sub sections (each followed by their contents),
+  // then its checks
+  if (isSection(node)) {
+    // skip contents of unchecked section if only checked items wanted
+    if (! checked || checkState(node) != Qt::Unchecked) {
+      const auto &section = nodeSection(node);
+
+      if (! section.sections.empty())
+        return section.sections[0];
+
+      int check = firstCheckNode(node, 0, checked);
+
+      if (check >= 0)
+        return check;
+    }
+
+    return nextSiblingItemNode(node, checked);
+  }
+
+  int parent = parentNode(node);
+
+  int check = firstCheckNode(parent, nodeInd(node) + 1, checked);
+
+  if (check >= 0)
+    return check;
+
+  return nextSiblingItemNode(parent, checked);
+}
+
+int
+CQCheckTreeModel::
+nextSiblingItemNode(int node, bool checked) const
+{
+  // node contents done so move to next section or first check of parent
+  // (repeat for parent if none)
+  while (node > ROOT_NODE) {
+    int parent = parentNode(node);
+
+    const auto &parentSection = nodeSection(parent);
+
+    size_t ind = size_t(nodeInd(node)) + 1;
+
+    if (ind < parentSection.sections.size())
+      return parentSection.sections[ind];
+
+    int check = firstCheckNode(parent, 0, checked);
+
+    if (check >= 0)
+      return check;
+
+    node = parent;
+  }
+
+  return -1;
+}
+
+int
+CQCheckTreeModel::
+firstCheckNode(int node, int i, bool checked) const
+{
+  // first (checked) check of section at or after index
+  const auto &section = nodeSection(node);
+
+  if (checked)
+    i = section.checkBits.findNext(i);
+
+  if (i < 0 || i >= int(section.checks.size()))
+    return -1;
+
+  return section.checks[size_t(i)];
+}
+
+int
+CQCheckTreeModel::
+countChecked(int node) const
+{
+  if (! isValidNode(node))
+    return 0;
+
+  if (! isSection(node))
+    return (isChecked(node) ? 1 : 0);
+
+  const auto &section = nodeSection(node);
+
+  if (section.lazy)
+    return int(section.lazyChecked);
+
+  int n = section.checkBits.count();
+
+  for (auto section1 : section.sections)
+    n += countChecked(section1);
+
+  return n;
+}
+
+//---
+
+namespace {
+
+// state file header
+const quint32 STATE_MAGIC   = 0x43514354; // "CQCT"
+const quint32 STATE_VERSION = 1;
+
+}
+
+bool
+CQCheckTreeModel::
+saveState(QIODevice &dev) const
+{
+  // format:
+  //   magic, version, structure fingerprint, number of sections
+  //   per section: path key, lazy check state, number of checks, check bit words
+  //   per section: number of checked checks, checked check labels
+  //
+  // the trailing labels are only read when the structure has changed
+  QDataStream out(&dev);
+
+  out.setVersion(QDataStream::Qt_5_0);
+
+  std::vector<int> sectionNodes;
+
+  for (int node = 0; node < numNodes(); ++node)
+    if (isValidNode(node) && isSection(node))
+      sectionNodes.push_back(node);
+
+  out << STATE_MAGIC << STATE_VERSION << structureFingerprint() <<
+         quint32(sectionNodes.size());
+
+  for (auto node : sectionNodes) {
+    const auto &section = nodeSection(node);
+
+    out << sectionKey(node) << qint8(section.lazy ? section.lazyOverride : -1) <<
+           quint32(section.checks.size());
+
+    for (auto w : section.checkBits.words())
+      out << quint64(w);
+  }
+
+  for (auto node : sectionNodes) {
+    const auto &section = nodeSection(node);
+
+    out << quint32(section.numChecked);
+
+    section.checkBits.forEachSet([&](int i) {
+      out << nodeText(section.checks[size_t(i)]);
+    });
+  }
+
+  return (out.status() == QDataStream::Ok);
+}
+
+bool
+CQCheckTreeModel::
+restoreState(QIODevice &dev)
+{
+  QDataStream in(&dev);
+
+  in.setVersion(QDataStream::Qt_5_0);
+
+  quint32 magic = 0, version = 0, numSections = 0;
+  quint64 fingerprint = 0;
+
+  in >> magic >> version >> fingerprint >> numSections;
+
+  if (in.status() != QDataStream::Ok || magic != STATE_MAGIC || version != STATE_VERSION)
+    return false;
+
+  struct SectionState {
+    QString         key;
+    qint8           lazyState { -1 };
+    CQCheckTreeBits bits;
+  };
+
+  // counts are not trusted for allocation (truncated or corrupt file fails
+  // when data runs out instead of allocating from a bad count)
+  std::vector<SectionState> sectionStates;
+
+  for (quint32 j = 0; j < numSections; ++j) {
+    SectionState sectionState;
+
+    quint32 numChecks = 0;
+
+    in >> sectionState.key >> sectionState.lazyState >> numChecks;
+
+    if (in.status() != QDataStream::Ok)
+      return false;
+
+    // check bit words must be in remaining data
+    quint64 numWords = (quint64(numChecks) + CQCheckTreeBits::WORD_BITS - 1)/
+                       CQCheckTreeBits::WORD_BITS;
+
+    if (numChecks > quint32(std::numeric_limits<int>::max()) ||
+        numWords*sizeof(quint64) > quint64(std::max(dev.bytesAvailable(), qint64(0))))
+      return false;
+
+    sectionState.bits.resize(int(numChecks));
+
+    for (size_t i = 0; i < sectionState.bits.words().size(); ++i) {
+      quint64 w = 0;
+
+      in >> w;
+
+      sectionState.bits.setWord(i, w);
+    }
+
+    sectionStates.push_back(std::move(sectionState));
+  }
+
+  // checked labels of each section (only used if structure differs but always
+  // read so truncated data fails before state is changed)
+  bool sameStructure = (fingerprint == structureFingerprint());
+
+  QSet<QString> checkedKeys;
+
+  for (const auto &sectionState : sectionStates) {
+    quint32 numChecked = 0;
+
+    in >> numChecked;
+
+    for (quint32 i = 0; i < numChecked && in.status() == QDataStream::Ok; ++i) {
+      QString label;
+
+      in >> label;
+
+      if (! sameStructure)
+        checkedKeys.insert(sectionState.key + KEY_SEP + label);
+    }
+  }
+
+  if (in.status() != QDataStream::Ok)
+    return false;
+
+  //---
+
+  beginCheckChange();
+
+  if (sameStructure) {
+    // same structure so sections are in same order with same check counts
+    size_t i = 0;
+
+    for (int node = 0; node < numNodes() && i < sectionStates.size(); ++node) {
+      if (! isValidNode(node) || ! isSection(node))
+        continue;
+
+      const auto &sectionState = sectionStates[i++];
+
+      // no saved lazy state is provider default
+      if (nodeSection(node).lazy) {
+        if (sectionState.lazyState >= 0)
+          setLazyChecked(node, sectionState.lazyState > 0);
+        else
+          resetLazyChecked(node);
+      }
+      else if (sectionState.bits.size() == numChecks(node))
+        setSectionBits(node, sectionState.bits);
+    }
+  }
+  else {
+    // match lazy states by section key and checked checks by section key and label
+    QHash<QString, qint8> lazyStates;
+
+    for (const auto &sectionState : sectionStates) {
+      if (sectionState.lazyState >= 0)
+        lazyStates[sectionState.key] = sectionState.lazyState;
+    }
+
+    // saved lazy state of section or nearest ancestor (whole subtree state,
+    // so sections are visited parents first)
+    std::vector<std::pair<int, qint8>> sectionNodes;
+
+    sectionNodes.push_back(std::make_pair(int(ROOT_NODE), qint8(-1)));
+
+    while (! sectionNodes.empty()) {
+      int   node  = sectionNodes.back().first;
+      qint8 state = sectionNodes.back().second;
+
+      sectionNodes.pop_back();
+
+      auto sectionKey1 = sectionKey(node);
+
+      auto p = lazyStates.find(sectionKey1);
+
+      if (p != lazyStates.end())
+        state = p.value();
+
+      const auto &section = nodeSection(node);
+
+      if (section.lazy) {
+        if (state >= 0)
+          setLazyChecked(node, state > 0);
+        else
+          resetLazyChecked(node);
+
+        continue;
+      }
+
+      for (auto section1 : section.sections)
+        sectionNodes.push_back(std::make_pair(section1, state));
+
+      CQCheckTreeBits bits;
+
+      bits.resize(int(section.checks.size()));
+
+      // section saved unfetched so all its checks have the saved state
+      if (state >= 0)
+        bits.fill(state > 0);
+      else {
+        auto key = sectionKey1 + KEY_SEP;
+
+        for (size_t i = 0; i < section.checks.size(); ++i) {
+          if (checkedKeys.contains(key + nodeText(section.checks[i])))
+            bits.set(int(i), true);
+        }
+      }
+
+      setSectionBits(node, bits);
+    }
+  }
+
+  endCheckChange();
+
+  return true;
+}
+
+void
+CQCheckTreeModel::
+setSectionBits(int node, const CQCheckTreeBits &bits)
+{
+  assert(isCheckChange());
+
+  auto oldState = checkState(node);
+
+  auto &section = nodeSection(node);
+
+  section.checkBits.forEachDiff(bits, [&](int i) {
+    addChangedNode(section.checks[size_t(i)], ! bits.test(i));
+  });
+
+  section.checkBits  = bits;
+  section.numChecked = uint(bits.count());
+
+  updateState(node, oldState);
+}
+
+QString
+CQCheckTreeModel::
+sectionKey(int node) const
+{
+  // labels of section path (empty for root)
+  if (node == ROOT_NODE)
+    return QString();
+
+  int parent = parentNode(node);
+
+  if (parent == ROOT_NODE)
+    return nodeText(node);
+
+  return sectionKey(parent) + KEY_SEP + nodeText(node);
+}
+
+quint64
+CQCheckTreeModel::
+structureFingerprint() const
+{
+  // FNV-1a of node parents, rows, types and labels (rows so saved check bits
+  // are not applied to reordered checks)
+  quint64 h = 14695981039346656037ULL;
+
+  auto add = [&](quint64 v) {
+    h ^= v;
+    h *= 1099511628211ULL;
+  };
+
+  for (const auto &n : nodes_) {
+    add(quint64(n.parent + 1));
+    add(quint64(n.row + 1));
+    add(quint64(n.isSection) | (n.isSection && sections_[size_t(n.section)].lazy ? 2 : 0) |
+        (n.removed ? 4 : 0));
+    add(quint64(n.labelLength));
+  }
+
+  const auto *c = labels_.constData();
+
+  for (int i = 0; i < labels_.size(); ++i)
+    add(quint64(c[i].unicode()));
+
+  return h;
+}
+
+//---
+
+CQCheckTreeModel::StructureSnapshotP
+CQCheckTreeModel::
+structureSnapshot() const
+{
+  if (structureSnapshot_)
+    return structureSnapshot_;
+
+  // update changed nodes and sections of copy (copies their blocks if shared
+  // with previous snapshot) then add new nodes and sections
+  auto &structure = structureCopy_;
+
+  size_t numNodes    = structure.nodes   .size();
+  size_t numSections = structure.sections.size();
+
+  auto sortUnique = [](std::vector<int> &inds) {
+    std::sort(inds.begin(), inds.end());
+
+    inds.erase(std::unique(inds.begin(), inds.end()), inds.end());
+  };
+
+  auto updateSection = [&](size_t i) {
+    auto &ss = structure.sections.ref(i);
+
+    ss.sections = sections_[i].sections;
+    ss.checks   = sections_[i].checks;
+  };
+
+  sortUnique(structureNodesDirty_);
+
+  for (auto node : structureNodesDirty_)
+    structure.nodes.ref(size_t(node)) = structureNode(node);
+
+  for (size_t i = numNodes; i < nodes_.size(); ++i)
+    structure.nodes.push_back(structureNode(int(i)));
+
+  sortUnique(structureSectionsDirty_);
+
+  for (auto i : structureSectionsDirty_)
+    updateSection(size_t(i));
+
+  structure.sections.resize(sections_.size());
+
+  for (size_t i = numSections; i < sections_.size(); ++i)
+    updateSection(i);
+
+  // section node of new sections and of reused section indices
+  for (auto node : structureNodesDirty_) {
+    const auto &n = nodes_[size_t(node)];
+
+    if (n.isSection && ! n.removed)
+      structure.sections.ref(size_t(n.section)).node = node;
+  }
+
+  for (size_t i = numNodes; i < nodes_.size(); ++i) {
+    if (nodes_[i].isSection)
+      structure.sections.ref(size_t(nodes_[i].section)).node = int(i);
+  }
+
+  structureNodesDirty_   .clear();
+  structureSectionsDirty_.clear();
+
+  structure.labels = labels_;
+
+  structureSnapshot_ = std::make_shared<StructureSnapshot>(structure);
+
+  return structureSnapshot_;
+}
+
+CQCheckTreeModel::StructureNode
+CQCheckTreeModel::
+structureNode(int node) const
+{
+  const auto &n = nodes_[size_t(node)];
+
+  StructureNode sn;
+
+  sn.parent      = n.parent;
+  sn.ind         = n.ind;
+  sn.section     = n.section;
+  sn.labelOffset = n.labelOffset;
+  sn.labelLength = n.labelLength;
+  sn.removed     = n.removed;
+
+  return sn;
+}
+
+void
+CQCheckTreeModel::
+markStructureNode(int node)
+{
+  structureSnapshot_.reset();
+
+  // new nodes are added to structure copy when snapshot is built
+  if (size_t(node) >= structureCopy_.nodes.size())
+    return;
+
+  // rebuild if more changes than nodes (bounds list while snapshot is unused)
+  if (structureNodesDirty_.size() >= nodes_.size()) {
+    resetStructure();
+    return;
+  }
+
+  structureNodesDirty_.push_back(node);
+}
+
+void
+CQCheckTreeModel::
+markStructureSection(int node)
+{
+  structureSnapshot_.reset();
+
+  int section = nodes_[size_t(node)].section;
+
+  if (size_t(section) >= structureCopy_.sections.size())
+    return;
+
+  if (structureSectionsDirty_.size() >= sections_.size()) {
+    resetStructure();
+    return;
+  }
+
+  structureSectionsDirty_.push_back(section);
+}
+
+void
+CQCheckTreeModel::
+resetStructure()
+{
+  structureSnapshot_.reset();
+
+  structureCopy_ = StructureSnapshot();
+
+  structureNodesDirty_   .clear();
+  structureSectionsDirty_.clear();
+}
+
+void
+CQCheckTreeModel::
+setSnapshotsEnabled(bool b)
+{
+  if (b == snapshotsEnabled_)
+    return;
+
+  snapshotsEnabled_ = b;
+
+  // unpublished sections must be queued again by next change
+  for (auto i : snapshotDirty_)
+    sections_[size_t(i)].snapshotDirty = false;
+
+  snapshotDirty_.clear();
+
+  snapshotReset_ = true;
+
+  if (snapshotsEnabled_)
+    publishSnapshot();
+  else
+    std::atomic_store(&snapshot_, SnapshotP());
+}
+
+CQCheckTreeModel::SnapshotP
+CQCheckTreeModel::
+snapshot() const
+{
+  return std::atomic_load(&snapshot_);
+}
+
+void
+CQCheckTreeModel::
+markSnapshotDirty(int node)
+{
+  if (! snapshotsEnabled_ || snapshotReset_)
+    return;
+
+  auto &n = nodes_[size_t(node)];
+
+  auto &section = sections_[size_t(n.section)];
+
+  if (! section.snapshotDirty) {
+    section.snapshotDirty = true;
+
+    snapshotDirty_.push_back(n.section);
+  }
+}
+
+void
+CQCheckTreeModel::
+schedulePublish()
+{
+  // node adds are batched into one publish when control returns to event loop
+  if (! snapshotsEnabled_ || publishPending_ || isBulkUpdate() || isFetching())
+    return;
+
+  publishPending_ = true;
+
+  QMetaObject::invokeMethod(this, "publishSnapshot", Qt::QueuedConnection);
+}
+
+void
+CQCheckTreeModel::
+publishSnapshot()
+{
+  publishPending_ = false;
+
+  if (! snapshotsEnabled_)
+    return;
+
+  using SectionState  = CQCheckTreeSnapshot::SectionState;
+  using SectionStates = CQCheckTreeSnapshot::SectionStates;
+
+  // share states of unchanged sections with previous snapshot
+  auto prev = std::atomic_load(&snapshot_);
+
+  SectionStates states;
+
+  if (prev && ! snapshotReset_)
+    states = prev->sectionStates();
+
+  size_t numPrev = states.size();
+
+  states.resize(sections_.size());
+
+  auto structure = structureSnapshot();
+
+  auto makeState = [&](size_t i) {
+    auto state = std::make_shared<SectionState>();
+
+    state->checkBits = sections_[i].checkBits;
+    state->state     = checkState(structure->sections[i].node);
+
+    states.ref(i) = std::move(state);
+  };
+
+  for (auto i : snapshotDirty_) {
+    sections_[size_t(i)].snapshotDirty = false;
+
+    if (size_t(i) < numPrev)
+      makeState(size_t(i));
+  }
+
+  snapshotDirty_.clear();
+
+  // new sections
+  for (size_t i = numPrev; i < sections_.size(); ++i)
+    makeState(i);
+
+  snapshotReset_ = false;
+
+  auto snapshot = std::make_shared<CQCheckTreeSnapshot>(structure, states,
+                                                        hierSep_, ++snapshotSerial_);
+
+  std::atomic_store(&snapshot_, SnapshotP(snapshot));
+}
+
+void
+CQCheckTreeModel::
+setStatsEnabled(bool b)
+{
+  if (b == isStatsEnabled())
+    return;
+
+  if (b)
+    stats_.reset(new CQCheckTreeStats);
+  else
+    stats_.reset();
+}
+
+void
+CQCheckTreeModel::
+resetStats()
+{
+  if (stats_)
+    stats_->reset();
+}
+
+void
+CQCheckTreeModel::
+setSearchIndexed(bool b)
+{
+  if (b == searchIndexed_)
+    return;
+
+  searchIndexed_ = b;
+
+  searchIndex_.clear();
+
+  if (searchIndexed_) {
+    for (int node = ROOT_NODE + 1; node < numNodes(); ++node) {
+      const auto &n = nodes_[size_t(node)];
+
+      if (n.removed)
+        continue;
+
+      searchIndex_.addLabel(node, labels_.constData() + n.labelOffset, int(n.labelLength));
+    }
+  }
+}
+
+std::vector<int>
+CQCheckTreeModel::
+findNodes(const QString &text) const
+{
+  std::vector<int> nodes;
+
+  // split into parent path and label
+  int pos = text.lastIndexOf(hierSep());
+
+  auto label = text.mid(pos + 1).toLower();
+  auto path  = (pos >= 0 ? text.left(pos) : QString());
+
+  if (label.isEmpty())
+    return nodes;
+
+  // check index candidates or all nodes for short labels
+  if (searchIndexed_ && label.length() >= CQCheckTreeSearchIndex::MIN_QUERY_LENGTH) {
+    std::vector<int> candidates;
+
+    searchIndex_.candidates(label, candidates);
+
+    for (auto node : candidates)
+      if (matchNode(node, label, path))
+        nodes.push_back(node);
+  }
+  else {
+    for (int node = ROOT_NODE + 1; node < numNodes(); ++node)
+      if (matchNode(node, label, path))
+        nodes.push_back(node);
+  }
+
+  return nodes;
+}
+
+std::vector<int>
+CQCheckTreeModel::
+findNodes(const QString &text, const std::vector<int> &nodes) const
+{
+  std::vector<int> nodes1;
+
+  int pos = text.lastIndexOf(hierSep());
+
+  auto label = text.mid(pos + 1).toLower();
+  auto path  = (pos >= 0 ? text.left(pos) : QString());
+
+  if (label.isEmpty())
+    return nodes1;
+
+  for (auto node : nodes)
+    if (matchNode(node, label, path))
+      nodes1.push_back(node);
+
+  return nodes1;
+}
+
+bool
+CQCheckTreeModel::
+matchNode(int node, const QString &label, const QString &path) const
+{
+  if (! isValidNode(node))
+    return false;
+
+  const auto &n = nodes_[size_t(node)];
+
+  auto labelRef = labels_.midRef(int(n.labelOffset), int(n.labelLength));
+
+  if (! labelRef.contains(label, Qt::CaseInsensitive))
+    return false;
+
+  if (! path.isEmpty()) {
+    if (n.parent <= ROOT_NODE)
+      return false;
+
+    if (! sectionHierName(n.parent).contains(path, Qt::CaseInsensitive))
+      return false;
+  }
+
+  return true;
+}
+
+//---
+
+QModelIndex
+CQCheckTreeModel::
+nodeModelIndex(int node, int column) const
+{
+  if (node <= ROOT_NODE || ! isValidNode(node))
+    return QModelIndex();
+
+  return createIndex(nodeRow(node), column, quintptr(node));
+}
+
+int
+CQCheckTreeModel::
+modelIndexNode(const QModelIndex &index) const
+{
+  if (! index.isValid())
+    return ROOT_NODE;
+
+  return int(index.internalId());
+}
+
+QModelIndex
+CQCheckTreeModel::
+index(int row, int column, const QModelIndex &parent) const
+{
+  if (row < 0 || column < 0 || column > CHECK_COLUMN)
+    return QModelIndex();
+
+  int node = modelIndexNode(parent);
+
+  if (! isValidNode(node) || ! isSection(node))
+    return QModelIndex();
+
+  const auto &section = nodeSection(node);
+
+  if (row >= int(section.children.size()))
+    return QModelIndex();
+
+  return createIndex(row, column, quintptr(section.children[size_t(row)]));
+}
+
+QModelIndex
+CQCheckTreeModel::
+parent(const QModelIndex &index) const
+{
+  if (! index.isValid())
+    return QModelIndex();
+
+  int node = modelIndexNode(index);
+
+  return nodeModelIndex(parentNode(node), TEXT_COLUMN);
+}
+
+int
+CQCheckTreeModel::
+rowCount(const QModelIndex &parent) const
+{
+  if (parent.column() > TEXT_COLUMN)
+    return 0;
+
+  int node = modelIndexNode(parent);
+
+  if (! isValidNode(node) || ! isSection(node))
+    return 0;
+
+  return int(nodeSection(node).children.size());
+}
+
+int
+CQCheckTreeModel::
+columnCount(const QModelIndex &) const
+{
+  return 2;
+}
+
+QVariant
+CQCheckTreeModel::
+data(const QModelIndex &index, int role) const
+{
+  if (! index.isValid())
+    return QVariant();
+
+  int node = modelIndexNode(index);
+
+  if      (index.column() == TEXT_COLUMN) {
+    if      (role == Qt::DisplayRole)
+      return nodeText(node);
+    else if (role == Qt::ToolTipRole)
+      return hierName(node);
+  }
+  else if (index.column() == CHECK_COLUMN) {
+    if (role == Qt::CheckStateRole)
+      return int(checkState(node));
+  }
+
+  return QVariant();
+}
+
+QVariant
+CQCheckTreeModel::
+headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    return QVariant();
+
+  if (section < 0 || section >= headers_.size())
+    return QVariant();
+
+  return headers_[section];
+}
+
+Qt::ItemFlags
+CQCheckTreeModel::
+flags(const QModelIndex &index) const
+{
+  if (! index.isValid())
+    return Qt::NoItemFlags;
+
+  Qt::ItemFlags flags = Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+
+  if (! isSection(modelIndexNode(index)))
+    flags |= Qt::ItemNeverHasChildren;
+
+  return flags;
+}
+
+bool
+CQCheckTreeModel::
+hasChildren(const QModelIndex &parent) const
+{
+  if (parent.column() > TEXT_COLUMN)
+    return false;
+
+  int node = modelIndexNode(parent);
+
+  if (! isValidNode(node) || ! isSection(node))
+    return false;
+
+  const auto &section = nodeSection(node);
+
+  if (section.lazy)
+    return (section.lazyChildren > 0);
+
+  return ! section.children.empty();
+}
+
+bool
+CQCheckTreeModel::
+canFetchMore(const QModelIndex &parent) const
+{
+  return (provider_ && isLazy(modelIndexNode(parent)));
+}
+
+void
+CQCheckTreeModel::
+fetchMore(const QModelIndex &parent)
+{
+  fetchNode(modelIndexNode(parent));
+}
+
+//------
+
+CQCheckTreeItemIterator &
+CQCheckTreeItemIterator::
+operator++()
+{
+  node_ = model_->nextItemNode(node_, checked_);
+
+  return *this;
+}
+
+//------
+
+bool
+CQCheckTreeItem::
+isSection() const
+{
+  return model_->isSection(node_);
+}
+
+QString
+CQCheckTreeItem::
+text() const
+{
+  return model_->nodeText(node_);
+}
+
+QString
+CQCheckTreeItem::
+hierName() const
+{
+  return model_->hierName(node_);
+}
+
+void
+CQCheckTreeItem::
+appendHierName(QString &str) const
+{
+  model_->appendHierName(node_, str);
+}
+
+Qt::CheckState
+CQCheckTreeItem::
+checkState() const
+{
+  return model_->checkState(node_);
+}
+
+bool
+CQCheckTreeItem::
+isChecked() const
+{
+  return model_->isChecked(node_);
+}
+
+CQCheckTreeIndex
+CQCheckTreeItem::
+index() const
+{
+  return model_->treeIndex(node_);
+}
@@ -0,0 +1,548 @@
+#include <CQCheckTreeRecorder.h>
+#include <CQCheckTree.h>
+#include <CQCheckTreeProvider.h>
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QHash>
+#include <QResizeEvent>
+
+#include <algorithm>
+
+namespace {
+
+// trace file header (version 1 has no lazy section data)
+const quint32 TRACE_MAGIC   = 0x43515452; // "CQTR"
+const quint32 TRACE_VERSION = 2;
+
+// provider of replayed lazy sections. Reports the recorded counts and fetches
+// the recorded number of placeholder checks (the recorded number of checked
+// checks checked) so an expand costs a provider fetch as when recorded.
+class CQCheckTreeTraceProvider : public QObject, public CQCheckTreeProvider {
+ public:
+  CQCheckTreeTraceProvider(QObject *parent) :
+   QObject(parent) {
+    setObjectName("traceProvider");
+  }
+
+  // lazy nodes by model node (trace node number)
+  void setNodes(const std::vector<CQCheckTreeTrace::Node> &nodes) {
+    lazyNodes_.clear();
+
+    for (size_t i = 0; i < nodes.size(); ++i)
+      if (nodes[i].isLazy)
+        lazyNodes_[int(i) + 1] = nodes[i];
+  }
+
+  int childCount(const CQCheckTreeModel *, int node) const override {
+    auto p = lazyNodes_.find(node);
+
+    return (p != lazyNodes_.end() ? p.value().numChildren : 0);
+  }
+
+  void checkCounts(const CQCheckTreeModel *, int node,
+                   int &numChecked, int &numChecks) const override {
+    auto p = lazyNodes_.find(node);
+
+    numChecked = (p != lazyNodes_.end() ? p.value().numChecked : 0);
+    numChecks  = (p != lazyNodes_.end() ? p.value().numChecks  : 0);
+  }
+
+  void fetchChildren(CQCheckTreeModel *model, int node) override {
+    auto p = lazyNodes_.find(node);
+
+    if (p == lazyNodes_.end() || p.value().numChildren <= 0)
+      return;
+
+    const auto &lazyNode = p.value();
+
+    QStringList labels;
+
+    for (int i = 0; i < lazyNode.numChildren; ++i)
+      labels << QString::number(i + 1);
+
+    (void) model->addChecks(node, labels);
+
+    int numChecked = std::min(lazyNode.numChecked, lazyNode.numChildren);
+
+    for (int i = 0; i < numChecked; ++i)
+      model->setChecked(model->checkNode(node, i), true);
+  }
+
+ private:
+  QHash<int, CQCheckTreeTrace::Node> lazyNodes_;
+};
+
+}
+
+bool
+CQCheckTreeTrace::
+write(QIODevice &dev) const
+{
+  // format:
+  //   magic, version, number of nodes
+  //   per node: parent, is section, label, is lazy
+  //             (lazy only) number of children, checked checks, checks
+  //   saved check state, tree size, number of events
+  //   per event: type, dt, type specific data
+  QDataStream out(&dev);
+
+  out.setVersion(QDataStream::Qt_5_0);
+
+  out << TRACE_MAGIC << TRACE_VERSION << quint32(nodes.size());
+
+  for (const auto &node : nodes) {
+    out << qint32(node.parent) << node.isSection << node.label << node.isLazy;
+
+    if (node.isLazy)
+      out << qint32(node.numChildren) << qint32(node.numChecked) << qint32(node.numChecks);
+  }
+
+  out << state << size << quint32(events.size());
+
+  for (const auto &event : events) {
+    out << quint8(event.type) << event.dt;
+
+    switch (event.type) {
+      case EventType::CLICK:
+        out << qint32(event.node) << quint8(event.column);
+        break;
+      case EventType::EXPAND:
+      case EventType::COLLAPSE:
+        out << qint32(event.node);
+        break;
+      case EventType::ACTION:
+        out << event.name;
+        break;
+      case EventType::RESIZE:
+        out << event.size;
+        break;
+    }
+  }
+
+  return (out.status() == QDataStream::Ok);
+}
+
+bool
+CQCheckTreeTrace::
+read(QIODevice &dev)
+{
+  QDataStream in(&dev);
+
+  in.setVersion(QDataStream::Qt_5_0);
+
+  quint32 magic = 0, version = 0, numNodes = 0;
+
+  in >> magic >> version >> numNodes;
+
+  if (in.status() != QDataStream::Ok || magic != TRACE_MAGIC ||
+      version < 1 || version > TRACE_VERSION)
+    return false;
+
+  nodes.clear();
+  events.clear();
+
+  for (quint32 i = 0; i < numNodes && in.status() == QDataStream::Ok; ++i) {
+    Node node;
+
+    qint32 parent = -1;
+
+    in >> parent >> node.isSection >> node.label;
+
+    if (version >= 2)
+      in >> node.isLazy;
+
+    if (node.isLazy) {
+      qint32 numChildren = 0, numChecked = 0, numChecks = 0;
+
+      in >> numChildren >> numChecked >> numChecks;
+
+      if (! node.isSection || numChildren < 0 || numChecked < 0 || numChecks < numChecked)
+        return false;
+
+      node.numChildren = numChildren;
+      node.numChecked  = numChecked;
+      node.numChecks   = numChecks;
+    }
+
+    // parent must be root or an earlier fetched section
+    if (parent < 0 || quint32(parent) > i ||
+        (parent > 0 && (! nodes[size_t(parent - 1)].isSection ||
+                        nodes[size_t(parent - 1)].isLazy)))
+      return false;
+
+    node.parent = parent;
+
+    nodes.push_back(node);
+  }
+
+  quint32 numEvents = 0;
+
+  in >> state >> size >> numEvents;
+
+  for (quint32 i = 0; i < numEvents && in.status() == QDataStream::Ok; ++i) {
+    Event event;
+
+    quint8 type = 0;
+
+    in >> type >> event.dt;
+
+    event.type = EventType(type);
+
+    switch (event.type) {
+      case EventType::CLICK: {
+        qint32 node   = -1;
+        quint8 column = 0;
+
+        in >> node >> column;
+
+        event.node   = node;
+        event.column = column;
+
+        break;
+      }
+      case EventType::EXPAND:
+      case EventType::COLLAPSE: {
+        qint32 node = -1;
+
+        in >> node;
+
+        event.node = node;
+
+        break;
+      }
+      case EventType::ACTION:
+        in >> event.name;
+        break;
+      case EventType::RESIZE:
+        in >> event.size;
+        break;
+      default:
+        return false;
+    }
+
+    events.push_back(event);
+  }
+
+  return (in.status() == QDataStream::Ok);
+}
+
+void
+CQCheckTreeTrace::
+restore(CQCheckTree *tree) const
+{
+  auto *model = tree->model();
+
+  // lazy sections fetch placeholder checks from stub provider (reused across
+  // restores)
+  bool hasLazy = std::any_of(nodes.begin(), nodes.end(),
+                             [](const Node &node) { return node.isLazy; });
+
+  if (hasLazy) {
+    auto *provider = dynamic_cast<CQCheckTreeTraceProvider *>(tree->provider());
+
+    if (! provider)
+      provider = new CQCheckTreeTraceProvider(tree);
+
+    provider->setNodes(nodes);
+
+    tree->setProvider(provider);
+  }
+
+  tree->beginBulkUpdate();
+
+  tree->clear();
+
+  // nodes are added in recorded order so node numbers match
+  for (const auto &node : nodes) {
+    if      (node.isLazy)
+      (void) model->addLazySection(node.parent, node.label);
+    else if (node.isSection)
+      (void) model->addSection(node.parent, node.label);
+    else
+      (void) model->addCheck(node.parent, node.label);
+  }
+
+  tree->endBulkUpdate();
+
+  QBuffer buffer;
+
+  buffer.setData(state);
+
+  if (buffer.open(QIODevice::ReadOnly))
+    (void) model->restoreState(buffer);
+
+  // initial state is not part of session
+  model->clearUndo();
+
+  if (size.isValid())
+    tree->resize(size);
+}
+
+//---
+
+CQCheckTreeRecorder::
+CQCheckTreeRecorder(CQCheckTree *tree) :
+ QObject(tree), tree_(tree)
+{
+  setObjectName("recorder");
+}
+
+CQCheckTreeRecorder::
+~CQCheckTreeRecorder()
+{
+}
+
+void
+CQCheckTreeRecorder::
+start()
+{
+  if (recording_)
+    stop();
+
+  auto *model = tree_->model();
+
+  trace_ = CQCheckTreeTrace();
+
+  pendingFetch_.clear();
+  fetched_     .clear();
+
+  numUnmapped_ = 0;
+
+  // trace nodes are numbered in pre-order with children in row order (without
+  // removed nodes) so replay adds siblings in the same order
+  nodeMap_.assign(size_t(model->numNodes()), -1);
+
+  std::vector<int> nodes { CQCheckTreeModel::ROOT_NODE };
+
+  while (! nodes.empty()) {
+    int node = nodes.back();
+
+    nodes.pop_back();
+
+    if (node == CQCheckTreeModel::ROOT_NODE)
+      nodeMap_[size_t(node)] = CQCheckTreeModel::ROOT_NODE;
+    else {
+      nodeMap_[size_t(node)] = int(trace_.nodes.size()) + 1;
+
+      CQCheckTreeTrace::Node node1;
+
+      node1.parent    = nodeMap_[size_t(model->parentNode(node))];
+      node1.isSection = model->isSection(node);
+      node1.label     = model->nodeText(node);
+
+      // unfetched lazy section has no children in model
+      if (model->isLazy(node)) {
+        node1.isLazy      = true;
+        node1.numChildren = model->lazyChildCount(node);
+        node1.numChecked  = model->countChecked(node);
+        node1.numChecks   = model->lazyCheckCount(node);
+      }
+
+      trace_.nodes.push_back(node1);
+    }
+
+    if (! model->isSection(node))
+      continue;
+
+    // children pushed last to first so first child is visited next
+    auto parentInd = model->nodeModelIndex(node);
+
+    for (int row = model->rowCount(parentInd) - 1; row >= 0; --row)
+      nodes.push_back(model->modelIndexNode(model->index(row, 0, parentInd)));
+  }
+
+  numTraceNodes_ = int(trace_.nodes.size());
+
+  QBuffer buffer(&trace_.state);
+
+  if (buffer.open(QIODevice::WriteOnly))
+    (void) model->saveState(buffer);
+
+  trace_.size = tree_->size();
+
+  connect(tree_->tree(), SIGNAL(clicked(const QModelIndex &)),
+          this, SLOT(clickedSlot(const QModelIndex &)));
+  connect(tree_->tree(), SIGNAL(expanded(const QModelIndex &)),
+          this, SLOT(expandedSlot(const QModelIndex &)));
+  connect(tree_->tree(), SIGNAL(collapsed(const QModelIndex &)),
+          this, SLOT(collapsedSlot(const QModelIndex &)));
+  connect(tree_, SIGNAL(menuActionTriggered(const QString &)),
+          this, SLOT(actionSlot(const QString &)));
+  connect(model, SIGNAL(rowsInserted(const QModelIndex &, int, int)),
+          this, SLOT(rowsInsertedSlot(const QModelIndex &, int, int)));
+
+  tree_->installEventFilter(this);
+
+  recording_ = true;
+
+  timer_.start();
+
+  lastTime_ = 0;
+}
+
+void
+CQCheckTreeRecorder::
+stop()
+{
+  if (! recording_)
+    return;
+
+  disconnect(tree_->tree(), nullptr, this, nullptr);
+  disconnect(tree_, nullptr, this, nullptr);
+  disconnect(tree_->model(), nullptr, this, nullptr);
+
+  tree_->removeEventFilter(this);
+
+  recording_ = false;
+}
+
+bool
+CQCheckTreeRecorder::
+eventFilter(QObject *obj, QEvent *e)
+{
+  if (obj == tree_ && e->type() == QEvent::Resize) {
+    CQCheckTreeTrace::Event event;
+
+    event.type = CQCheckTreeTrace::EventType::RESIZE;
+    event.size = static_cast<QResizeEvent *>(e)->size();
+
+    addEvent(event);
+  }
+
+  return QObject::eventFilter(obj, e);
+}
+
+void
+CQCheckTreeRecorder::
+addEvent(CQCheckTreeTrace::Event &event)
+{
+  bool nodeEvent = (event.type == CQCheckTreeTrace::EventType::CLICK ||
+                    event.type == CQCheckTreeTrace::EventType::EXPAND ||
+                    event.type == CQCheckTreeTrace::EventType::COLLAPSE);
+
+  if (nodeEvent && event.node < 0)
+    ++numUnmapped_;
+
+  qint64 t = timer_.elapsed();
+
+  event.dt = quint32(t - lastTime_);
+
+  lastTime_ = t;
+
+  trace_.events.push_back(event);
+}
+
+int
+CQCheckTreeRecorder::
+traceNode(const QModelIndex &index)
+{
+  // children of fetched lazy sections are numbered once fetch has finished
+  mapFetched();
+
+  // other nodes added while recording are not in trace
+  int node = tree_->model()->modelIndexNode(index);
+
+  if (node < 0 || node >= int(nodeMap_.size()))
+    return -1;
+
+  return nodeMap_[size_t(node)];
+}
+
+void
+CQCheckTreeRecorder::
+mapFetched()
+{
+  if (pendingFetch_.empty())
+    return;
+
+  auto *model = tree_->model();
+
+  if (nodeMap_.size() < size_t(model->numNodes()))
+    nodeMap_.resize(size_t(model->numNodes()), -1);
+
+  // replay's stub provider adds the recorded number of children of each lazy
+  // section (in fetch order) so they get the next node numbers in row order
+  for (auto node : pendingFetch_) {
+    const auto &lazyNode = trace_.nodes[size_t(nodeMap_[size_t(node)] - 1)];
+
+    auto parentInd = model->nodeModelIndex(node);
+
+    int numRows = std::min(model->rowCount(parentInd), lazyNode.numChildren);
+
+    for (int row = 0; row < numRows; ++row) {
+      int child = model->modelIndexNode(model->index(row, 0, parentInd));
+
+      nodeMap_[size_t(child)] = ++numTraceNodes_;
+    }
+  }
+
+  pendingFetch_.clear();
+}
+
+void
+CQCheckTreeRecorder::
+clickedSlot(const QModelIndex &index)
+{
+  CQCheckTreeTrace::Event event;
+
+  event.type   = CQCheckTreeTrace::EventType::CLICK;
+  event.node   = traceNode(index);
+  event.column = index.column();
+
+  addEvent(event);
+}
+
+void
+CQCheckTreeRecorder::
+expandedSlot(const QModelIndex &index)
+{
+  CQCheckTreeTrace::Event event;
+
+  event.type = CQCheckTreeTrace::EventType::EXPAND;
+  event.node = traceNode(index);
+
+  addEvent(event);
+}
+
+void
+CQCheckTreeRecorder::
+collapsedSlot(const QModelIndex &index)
+{
+  CQCheckTreeTrace::Event event;
+
+  event.type = CQCheckTreeTrace::EventType::COLLAPSE;
+  event.node = traceNode(index);
+
+  addEvent(event);
+}
+
+void
+CQCheckTreeRecorder::
+actionSlot(const QString &name)
+{
+  CQCheckTreeTrace::Event event;
+
+  event.type = CQCheckTreeTrace::EventType::ACTION;
+  event.name = name;
+
+  addEvent(event);
+}
+
+void
+CQCheckTreeRecorder::
+rowsInsertedSlot(const QModelIndex &parent, int, int)
+{
+  // first rows inserted in recorded lazy section are its fetched children
+  int node = tree_->model()->modelIndexNode(parent);
+
+  if (node <= 0 || node >= int(nodeMap_.size()) || nodeMap_[size_t(node)] <= 0)
+    return;
+
+  int traceNode1 = nodeMap_[size_t(node)];
+
+  if (! trace_.nodes[size_t(traceNode1 - 1)].isLazy || ! fetched_.insert(traceNode1).second)
+    return;
+
+  pendingFetch_.push_back(node);
+}
@@ -0,0 +1,147 @@
+#include <CQCheckTreeSearchIndex.h>
+
+#include <algorithm>
+
+void
+CQCheckTreeSearchIndex::
+clear()
+{
+  postings_.clear();
+
+  removedNodes_   .clear();
+  removedTrigrams_.clear();
+}
+
+void
+CQCheckTreeSearchIndex::
+addLabel(int node, const QChar *label, int len)
+{
+  if (len < MIN_QUERY_LENGTH)
+    return;
+
+  QChar c1 = label[0].toLower();
+  QChar c2 = label[1].toLower();
+
+  for (int i = 2; i < len; ++i) {
+    QChar c3 = label[i].toLower();
+
+    auto &nodes = postings_[trigram(c1, c2, c3)];
+
+    // trigram can repeat in label
+    if      (nodes.empty() || nodes.back() < node)
+      nodes.push_back(node);
+    else if (nodes.back() != node) {
+      auto p = std::lower_bound(nodes.begin(), nodes.end(), node);
+
+      if (*p != node)
+        nodes.insert(p, node);
+    }
+
+    c1 = c2;
+    c2 = c3;
+  }
+}
+
+void
+CQCheckTreeSearchIndex::
+removeLabel(int node, const QChar *label, int len)
+{
+  if (len < MIN_QUERY_LENGTH)
+    return;
+
+  removedNodes_.push_back(node);
+
+  QChar c1 = label[0].toLower();
+  QChar c2 = label[1].toLower();
+
+  for (int i = 2; i < len; ++i) {
+    QChar c3 = label[i].toLower();
+
+    removedTrigrams_.push_back(trigram(c1, c2, c3));
+
+    c1 = c2;
+    c2 = c3;
+  }
+}
+
+void
+CQCheckTreeSearchIndex::
+flushRemoved()
+{
+  if (removedNodes_.empty())
+    return;
+
+  std::sort(removedNodes_.begin(), removedNodes_.end());
+
+  std::sort(removedTrigrams_.begin(), removedTrigrams_.end());
+
+  removedTrigrams_.erase(std::unique(removedTrigrams_.begin(), removedTrigrams_.end()),
+                         removedTrigrams_.end());
+
+  for (auto t : removedTrigrams_) {
+    auto p = postings_.find(t);
+
+    if (p == postings_.end())
+      continue;
+
+    auto &nodes = p.value();
+
+    nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [&](int node) {
+      return std::binary_search(removedNodes_.begin(), removedNodes_.end(), node);
+    }), nodes.end());
+
+    if (nodes.empty())
+      postings_.erase(p);
+  }
+
+  removedNodes_   .clear();
+  removedTrigrams_.clear();
+}
+
+void
+CQCheckTreeSearchIndex::
+candidates(const QString &text, Nodes &nodes) const
+{
+  nodes.clear();
+
+  int len = text.length();
+
+  if (len < MIN_QUERY_LENGTH)
+    return;
+
+  // posting lists of query trigrams (smallest first)
+  std::vector<const Nodes *> lists;
+
+  for (int i = 2; i < len; ++i) {
+    auto p = postings_.find(trigram(text[i - 2], text[i - 1], text[i]));
+
+    if (p == postings_.end())
+      return;
+
+    lists.push_back(&p.value());
+  }
+
+  std::sort(lists.begin(), lists.end(), [](const Nodes *lhs, const Nodes *rhs) {
+    if (lhs->size() != rhs->size())
+      return lhs->size() < rhs->size();
+
+    return lhs < rhs;
+  });
+
+  lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+  //---
+
+  nodes = *lists[0];
+
+  Nodes nodes1;
+
+  for (size_t i = 1; i < lists.size() && ! nodes.empty(); ++i) {
+    nodes1.clear();
+
+    std::set_intersection(nodes.begin(), nodes.end(), lists[i]->begin(), lists[i]->end(),
+                          std::back_inserter(nodes1));
+
+    std::swap(nodes, nodes1);
+  }
+}
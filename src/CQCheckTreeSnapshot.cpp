@@ -0,0 +1,105 @@
+#include <CQCheckTreeSnapshot.h>
+
+CQCheckTreeSnapshot::
+CQCheckTreeSnapshot(const StructureSnapshotP &structure, const SectionStates &states,
+                    const QChar &hierSep, uint serial) :
+ structure_(structure), states_(states), hierSep_(hierSep), serial_(serial)
+{
+  assert(states_.size() == structure_->sections.size());
+}
+
+QString
+CQCheckTreeSnapshot::
+nodeText(int node) const
+{
+  const auto &n = structureNode(node);
+
+  return structure_->labels.mid(int(n.labelOffset), int(n.labelLength));
+}
+
+QString
+CQCheckTreeSnapshot::
+hierName(int node) const
+{
+  // snapshot has no name cache so build from ancestor labels
+  std::vector<int> nodes;
+
+  for (int node1 = node; node1 > CQCheckTreeModel::ROOT_NODE; node1 = parentNode(node1))
+    nodes.push_back(node1);
+
+  QString str;
+
+  for (auto p = nodes.rbegin(); p != nodes.rend(); ++p) {
+    const auto &n = structureNode(*p);
+
+    if (p != nodes.rbegin())
+      str += hierSep_;
+
+    str.append(structure_->labels.constData() + n.labelOffset, int(n.labelLength));
+  }
+
+  return str;
+}
+
+bool
+CQCheckTreeSnapshot::
+isChecked(int node) const
+{
+  if (! isValidNode(node))
+    return false;
+
+  return (checkState(node) == Qt::Checked);
+}
+
+Qt::CheckState
+CQCheckTreeSnapshot::
+checkState(int node) const
+{
+  const auto &n = structureNode(node);
+
+  if (n.section >= 0)
+    return states_[size_t(n.section)]->state;
+
+  const auto &pn = structureNode(n.parent);
+
+  return (states_[size_t(pn.section)]->checkBits.test(n.ind) ? Qt::Checked : Qt::Unchecked);
+}
+
+int
+CQCheckTreeSnapshot::
+treeIndexNode(const CQCheckTreeIndex &ind) const
+{
+  const auto &sections = structure_->sections;
+
+  int node = CQCheckTreeModel::ROOT_NODE;
+
+  int depth = ind.depth();
+
+  for (int i = 0; i < depth; ++i) {
+    const auto &section = sections[size_t(structureNode(node).section)];
+
+    int ind1 = ind.sectionPathInd(i);
+
+    if (ind1 < 0 || ind1 >= int(section.sections.size()))
+      return -1;
+
+    node = section.sections[size_t(ind1)];
+  }
+
+  if (ind.itemInd < 0)
+    return node;
+
+  const auto &section = sections[size_t(structureNode(node).section)];
+
+  if (ind.itemInd >= int(section.checks.size()))
+    return -1;
+
+  return section.checks[size_t(ind.itemInd)];
+}
+
+bool
+CQCheckTreeSnapshot::
+isChecked(const CQCheckTreeIndex &ind) const
+{
+  return isChecked(treeIndexNode(ind));
+}
@@ -0,0 +1,602 @@
+#include <CQCheckTreeModel.h>
+#include <CQCheckTreeProvider.h>
+#include <CQCheckTreeSnapshot.h>
+#include <QBuffer>
+#include <QCoreApplication>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// checks of model structure, iteration, state save/restore, undo and
+// snapshots (no widgets).
+//
+// Usage: CQCheckTreeModelTest
+//
+// Prints each failed check and returns the number of failures.
+
+#define CHECK(COND) \
+  do { \
+    if (! (COND)) { \
+      printf("%s:%d: FAILED: %s\n", __FILE__, __LINE__, #COND); \
+      ++s_numFailed; \
+    } \
+  } while (0)
+
+namespace {
+
+int s_numFailed = 0;
+
+// provider of lazy sections with three unchecked checks
+class CQCheckTreeTestProvider : public CQCheckTreeProvider {
+ public:
+  int childCount(const CQCheckTreeModel *, int) const override { return 3; }
+
+  void checkCounts(const CQCheckTreeModel *, int, int &numChecked, int &numChecks) const override {
+    numChecked = 0;
+    numChecks  = 3;
+  }
+
+  void fetchChildren(CQCheckTreeModel *model, int node) override {
+    (void) model->addChecks(node, QStringList() << "1" << "2" << "3");
+  }
+};
+
+}
+
+//---
+
+// node of path of child labels (-1 if not found)
+int
+findNode(const CQCheckTreeModel *model, const QString &path)
+{
+  QModelIndex parent;
+
+  for (const auto &label : path.split(model->hierSep())) {
+    int row     = 0;
+    int numRows = model->rowCount(parent);
+
+    for ( ; row < numRows; ++row) {
+      if (model->nodeText(model->modelIndexNode(model->index(row, 0, parent))) == label)
+        break;
+    }
+
+    if (row >= numRows)
+      return -1;
+
+    parent = model->index(row, 0, parent);
+  }
+
+  return model->modelIndexNode(parent);
+}
+
+bool
+isPathChecked(const CQCheckTreeModel *model, const QString &path)
+{
+  int node = findNode(model, path);
+
+  return (node >= 0 && model->isChecked(node));
+}
+
+QByteArray
+saveState(const CQCheckTreeModel *model)
+{
+  QBuffer buffer;
+
+  if (! buffer.open(QIODevice::WriteOnly) || ! model->saveState(buffer))
+    return QByteArray();
+
+  return buffer.data();
+}
+
+bool
+restoreState(CQCheckTreeModel *model, const QByteArray &data)
+{
+  QBuffer buffer;
+
+  buffer.setData(data);
+
+  if (! buffer.open(QIODevice::ReadOnly))
+    return false;
+
+  return model->restoreState(buffer);
+}
+
+//---
+
+// reconciled (reordered and extended) tree keeps check state and saved state
+// restores to same and differently ordered structure
+void
+testContentsState()
+{
+  CQCheckTreeModel model;
+
+  model.addCheckPaths(QStringList() << "a/x" << "a/y" << "b/z" << "b/w");
+
+  model.setChecked(findNode(&model, "a/y"), true);
+  model.setChecked(findNode(&model, "b/z"), true);
+
+  model.setContents(QStringList() << "b/w" << "b/z" << "a/y" << "a/x" << "c/v");
+
+  CHECK(findNode(&model, "c/v") >= 0);
+  CHECK(isPathChecked(&model, "a/y") && isPathChecked(&model, "b/z"));
+  CHECK(! isPathChecked(&model, "a/x") && ! isPathChecked(&model, "b/w"));
+  CHECK(model.countChecked(CQCheckTreeModel::ROOT_NODE) == 2);
+
+  auto data = saveState(&model);
+
+  CHECK(! data.isEmpty());
+
+  // same model (matching fingerprint)
+  model.setChecked(findNode(&model, "a/y"), false);
+  model.setChecked(findNode(&model, "b/z"), false);
+
+  CHECK(model.countChecked(CQCheckTreeModel::ROOT_NODE) == 0);
+
+  CHECK(restoreState(&model, data));
+  CHECK(isPathChecked(&model, "a/y") && isPathChecked(&model, "b/z"));
+  CHECK(model.countChecked(CQCheckTreeModel::ROOT_NODE) == 2);
+
+  // model built in different order (checks matched by path)
+  CQCheckTreeModel model1;
+
+  model1.addCheckPaths(QStringList() << "c/v" << "a/x" << "a/y" << "b/z" << "b/w");
+
+  CHECK(model1.structureFingerprint() != model.structureFingerprint());
+
+  CHECK(restoreState(&model1, data));
+  CHECK(isPathChecked(&model1, "a/y") && isPathChecked(&model1, "b/z"));
+  CHECK(model1.countChecked(CQCheckTreeModel::ROOT_NODE) == 2);
+}
+
+// lazy section saved without checked state set restores to provider's counts
+void
+testLazyState()
+{
+  CQCheckTreeTestProvider provider;
+
+  CQCheckTreeModel model;
+
+  model.setProvider(&provider);
+
+  int lazy = model.addLazySection(CQCheckTreeModel::ROOT_NODE, "lazy");
+
+  auto data = saveState(&model);
+
+  // same model (matching fingerprint)
+  model.setChecked(lazy, true);
+
+  CHECK(model.countChecked(lazy) == 3);
+
+  CHECK(restoreState(&model, data));
+  CHECK(model.isLazy(lazy));
+  CHECK(model.countChecked(lazy) == 0);
+
+  // restore is undoable
+  model.undo();
+
+  CHECK(model.countChecked(lazy) == 3);
+
+  // model with different structure (sections matched by path)
+  CQCheckTreeModel model1;
+
+  model1.setProvider(&provider);
+
+  (void) model1.addCheckPath("a/x");
+
+  int lazy1 = model1.addLazySection(CQCheckTreeModel::ROOT_NODE, "lazy");
+
+  model1.setChecked(lazy1, true);
+
+  CHECK(restoreState(&model1, data));
+  CHECK(model1.countChecked(lazy1) == 0);
+}
+
+// lazy section checked before fetch is undone and redone after fetch
+void
+testLazyUndo()
+{
+  CQCheckTreeTestProvider provider;
+
+  CQCheckTreeModel model;
+
+  model.setProvider(&provider);
+
+  int lazy = model.addLazySection(CQCheckTreeModel::ROOT_NODE, "lazy");
+
+  CHECK(model.isLazy(lazy));
+
+  model.setChecked(lazy, true);
+
+  CHECK(model.canUndo());
+  CHECK(model.countChecked(lazy) == 3);
+
+  model.fetchNode(lazy);
+
+  CHECK(! model.isLazy(lazy));
+  CHECK(model.numChecks(lazy) == 3);
+  CHECK(model.countChecked(lazy) == 3);
+  CHECK(model.canUndo());
+
+  model.undo();
+
+  CHECK(model.countChecked(lazy) == 0);
+  CHECK(! model.isChecked(model.checkNode(lazy, 0)));
+  CHECK(model.canRedo());
+
+  model.redo();
+
+  CHECK(model.countChecked(lazy) == 3);
+  CHECK(model.isChecked(model.checkNode(lazy, 2)));
+}
+
+// check changes after fetch undo back to lazy state set before fetch
+void
+testLazyUndoSteps()
+{
+  CQCheckTreeTestProvider provider;
+
+  CQCheckTreeModel model;
+
+  model.setProvider(&provider);
+
+  int lazy = model.addLazySection(CQCheckTreeModel::ROOT_NODE, "lazy");
+
+  model.setChecked(lazy, true);
+
+  model.fetchNode(lazy);
+
+  int check = model.checkNode(lazy, 1);
+
+  model.setChecked(check, false);
+
+  CHECK(model.countChecked(lazy) == 2);
+
+  // undo fetched check change then lazy state change
+  model.undo();
+
+  CHECK(model.countChecked(lazy) == 3);
+
+  model.undo();
+
+  CHECK(model.countChecked(lazy) == 0);
+  CHECK(! model.canUndo());
+
+  model.redo();
+  model.redo();
+
+  CHECK(model.countChecked(lazy) == 2 && ! model.isChecked(check));
+}
+
+// truncated or corrupt saved state is rejected without changing state
+void
+testTruncatedState()
+{
+  CQCheckTreeModel model;
+
+  model.addCheckPaths(QStringList() << "a/x" << "a/y" << "b/z" << "b/w");
+
+  model.setChecked(findNode(&model, "a/y"), true);
+
+  auto data = saveState(&model);
+
+  CHECK(data.size() > 8);
+
+  model.setChecked(findNode(&model, "a/y"), false);
+
+  for (int len = 0; len < data.size(); ++len) {
+    if (restoreState(&model, data.left(len))) {
+      printf("truncated state of %d/%d bytes restored\n", len, int(data.size()));
+      CHECK(false);
+    }
+  }
+
+  CHECK(model.countChecked(CQCheckTreeModel::ROOT_NODE) == 0);
+
+  // bad magic
+  auto data1 = data;
+
+  data1[0] = char(data1[0] ^ 0xff);
+
+  CHECK(! restoreState(&model, data1));
+
+  CHECK(model.countChecked(CQCheckTreeModel::ROOT_NODE) == 0);
+
+  // whole state still restores
+  CHECK(restoreState(&model, data));
+  CHECK(isPathChecked(&model, "a/y"));
+}
+
+// section changed but not published before snapshots are disabled is
+// published by later changes when enabled again
+void
+testSnapshotEnable()
+{
+  CQCheckTreeModel model;
+
+  model.addCheckPaths(QStringList() << "a/x");
+
+  model.setSnapshotsEnabled(true);
+
+  // marks section changed (publish is queued)
+  (void) model.addCheck(findNode(&model, "a"), "y");
+
+  model.setSnapshotsEnabled(false);
+  model.setSnapshotsEnabled(true);
+
+  int x = findNode(&model, "a/x");
+
+  model.setChecked(x, true);
+
+  auto snapshot = model.snapshot();
+
+  CHECK(snapshot && snapshot->isChecked(x));
+}
+
+// shallow and deep tree indices map back to their nodes and copy by value
+void
+testTreeIndex()
+{
+  // three ints and a pointer (plus padding)
+  CHECK(sizeof(CQCheckTreeIndex) <= 3*sizeof(int) + sizeof(int *) + sizeof(int));
+
+  CQCheckTreeModel model;
+
+  model.addCheckPaths(QStringList() << "a/x" << "a/b/y" << "a/b/c/d/e/f/z");
+
+  for (const auto &path : QStringList() << "a/x" << "a/b/y" << "a/b/c/d/e/f/z") {
+    int node = findNode(&model, path);
+
+    auto ind = model.treeIndex(node);
+
+    CHECK(ind.depth() == path.count('/'));
+    CHECK(model.treeIndexNode(ind) == node);
+
+    // copy and assign keep deep levels
+    auto ind1 = ind;
+
+    CHECK(ind1 == ind);
+
+    CQCheckTreeIndex ind2(0, 0);
+
+    ind2 = ind1;
+
+    CHECK(ind2 == ind && model.treeIndexNode(ind2) == node);
+
+    // moved from index is empty
+    auto ind3 = std::move(ind1);
+
+    CHECK(ind3 == ind && ind1.subInds.size() == 0);
+  }
+
+  // section index of deep check is its parent section
+  int z = findNode(&model, "a/b/c/d/e/f/z");
+
+  auto sectionInd = model.treeIndex(z).sectionIndex();
+
+  CHECK(model.sectionIndexNode(sectionInd) == findNode(&model, "a/b/c/d/e/f"));
+  CHECK(sectionInd < model.treeIndex(z));
+}
+
+// reference item order (section followed by its contents, sub sections before
+// checks) built recursively
+void
+addRefItems(const CQCheckTreeModel *model, int node, bool checked, std::vector<int> &nodes)
+{
+  for (int i = 0; i < model->numSections(node); ++i) {
+    int section = model->sectionNode(node, i);
+
+    if (! checked || model->checkState(section) == Qt::Checked)
+      nodes.push_back(section);
+
+    addRefItems(model, section, checked, nodes);
+  }
+
+  for (int i = 0; i < model->numChecks(node); ++i) {
+    int check = model->checkNode(node, i);
+
+    if (! checked || model->isChecked(check))
+      nodes.push_back(check);
+  }
+}
+
+// iterators and item lists visit all/checked items in reference order
+void
+testItemOrder()
+{
+  CQCheckTreeModel model;
+
+  model.addCheckPaths(QStringList() << "a/x" << "a/b/y" << "a/z" << "c" <<
+                      "a/b/d/w" << "e/f/v" << "e/u");
+
+  model.setChecked(findNode(&model, "a/b"), true);
+  model.setChecked(findNode(&model, "a/z"), true);
+  model.setChecked(findNode(&model, "c"  ), true);
+
+  for (bool checked : { false, true }) {
+    std::vector<int> refNodes;
+
+    addRefItems(&model, CQCheckTreeModel::ROOT_NODE, checked, refNodes);
+
+    std::vector<int> nodes;
+
+    for (const auto &item : (checked ? model.checkedItems() : model.items()))
+      nodes.push_back(item.node());
+
+    CHECK(nodes == refNodes);
+
+    auto items = (checked ? model.getCheckedItems() : model.getAllItems());
+
+    CHECK(items.size() == refNodes.size());
+
+    for (size_t i = 0; i < std::min(items.size(), refNodes.size()); ++i)
+      CHECK(items[i].node() == refNodes[i]);
+  }
+
+  // visitor stops when callback returns false
+  int n = 0;
+
+  CHECK(! model.forEachItem([&](const CQCheckTreeItem &) { return ++n < 3; }));
+  CHECK(n == 3);
+}
+
+// removed rows compact later siblings, keep state and undo steps of remaining
+// checks, reuse removed ids and keep remaining labels when label storage is
+// compacted
+void
+testRemove()
+{
+  CQCheckTreeModel model;
+
+  model.addCheckPaths(QStringList() << "a/x1" << "a/x2" << "a/x3" << "a/x4" << "a/x5" << "b/y");
+
+  int a  = findNode(&model, "a");
+  int x2 = findNode(&model, "a/x2");
+  int x3 = findNode(&model, "a/x3");
+  int x4 = findNode(&model, "a/x4");
+  int x5 = findNode(&model, "a/x5");
+
+  model.setChecked(x2, true);
+  model.setChecked(x4, true);
+
+  // remove x2 and x3 (later checks move up)
+  CHECK(model.removeRange(a, 1, 2));
+
+  CHECK(model.numChecks(a) == 3);
+  CHECK(model.checkNode(a, 1) == x4 && model.checkNode(a, 2) == x5);
+  CHECK(model.treeIndex(x4).itemInd == 1);
+  CHECK(model.isChecked(x4) && ! model.isChecked(x5));
+  CHECK(model.countChecked(a) == 1);
+  CHECK(model.countChecked(CQCheckTreeModel::ROOT_NODE) == 1);
+
+  // undo follows compacted index of x4 (step of removed x2 is dropped)
+  model.undo();
+
+  CHECK(! model.isChecked(x4) && ! model.isChecked(x5));
+  CHECK(model.countChecked(CQCheckTreeModel::ROOT_NODE) == 0);
+
+  while (model.canUndo())
+    model.undo();
+
+  CHECK(model.countChecked(CQCheckTreeModel::ROOT_NODE) == 0);
+
+  // removed ids are reused
+  int numNodes = model.numNodes();
+
+  int n1 = model.addCheck(a, "n1");
+
+  CHECK(n1 == x2 || n1 == x3);
+  CHECK(model.numNodes() == numNodes);
+  CHECK(model.nodeText(n1) == "n1" && ! model.isChecked(n1));
+  CHECK(model.checkNode(a, 3) == n1);
+
+  // removed section's subtree is removed and its ids reused
+  int b = findNode(&model, "b");
+
+  CHECK(model.removeSection(b));
+  CHECK(findNode(&model, "b") < 0 && findNode(&model, "b/y") < 0);
+
+  int c = model.addSection(CQCheckTreeModel::ROOT_NODE, "c");
+
+  CHECK(model.numNodes() == numNodes);
+  CHECK(model.nodeText(c) == "c" && model.numChecks(c) == 0);
+
+  // remove enough label text to compact label storage
+  int big = model.addSection(CQCheckTreeModel::ROOT_NODE, "big");
+
+  QStringList labels;
+
+  for (int i = 0; i < 100; ++i)
+    labels << QString("long label %1 ").arg(i).repeated(8);
+
+  (void) model.addChecks(big, labels);
+
+  CHECK(model.removeSection(big));
+
+  CHECK(model.nodeText(a) == "a" && model.nodeText(x4) == "x4" && model.nodeText(n1) == "n1");
+  CHECK(model.hierName(x5) == "a/x5");
+  CHECK(findNode(&model, "c") == c);
+  CHECK(model.getAllItems().size() == 6);
+}
+
+// row of node in parent
+int
+nodeRow(const CQCheckTreeModel *model, int node)
+{
+  return model->nodeModelIndex(node).row();
+}
+
+// reordered children keep their nodes, check state and undo steps
+void
+testReorder()
+{
+  CQCheckTreeModel model;
+
+  model.addCheckPaths(QStringList() << "a/x" << "a/y" << "a/z" << "b/w" << "b/v");
+
+  int a = findNode(&model, "a");
+  int b = findNode(&model, "b");
+  int x = findNode(&model, "a/x");
+  int y = findNode(&model, "a/y");
+  int z = findNode(&model, "a/z");
+  int v = findNode(&model, "b/v");
+
+  model.setChecked(z, true);
+  model.setChecked(x, true);
+
+  model.setContents(QStringList() << "b/v" << "b/w" << "a/z" << "a/x" << "a/y");
+
+  // same nodes moved to paths order
+  CHECK(findNode(&model, "a") == a && findNode(&model, "a/z") == z);
+  CHECK(nodeRow(&model, b) == 0 && nodeRow(&model, a) == 1);
+  CHECK(nodeRow(&model, z) == 0 && nodeRow(&model, x) == 1 && nodeRow(&model, y) == 2);
+  CHECK(nodeRow(&model, v) == 0);
+
+  // check indices follow rows
+  CHECK(model.checkNode(a, 0) == z && model.checkNode(a, 1) == x && model.checkNode(a, 2) == y);
+  CHECK(model.treeIndex(z).itemInd == 0 && model.treeIndexNode(model.treeIndex(y)) == y);
+
+  CHECK(model.isChecked(z) && model.isChecked(x) && ! model.isChecked(y));
+  CHECK(model.countChecked(a) == 2 && model.countChecked(b) == 0);
+
+  // undo step of x follows its new index
+  model.undo();
+
+  CHECK(! model.isChecked(x) && model.isChecked(z) && ! model.isChecked(y));
+
+  model.redo();
+
+  CHECK(model.isChecked(x) && model.isChecked(z) && ! model.isChecked(y));
+
+  // single row move
+  CHECK(model.moveRow(a, 0, 2));
+
+  CHECK(nodeRow(&model, x) == 0 && nodeRow(&model, y) == 1 && nodeRow(&model, z) == 2);
+  CHECK(model.checkNode(a, 2) == z && model.isChecked(z));
+
+  model.undo();
+
+  CHECK(! model.isChecked(x) && model.isChecked(z) && ! model.isChecked(y));
+}
+
+int
+main(int argc, char **argv)
+{
+  QCoreApplication app(argc, argv);
+
+  testContentsState();
+  testLazyState();
+  testLazyUndo();
+  testLazyUndoSteps();
+  testTruncatedState();
+  testSnapshotEnable();
+  testTreeIndex();
+  testItemOrder();
+  testRemove();
+  testReorder();
+
+  if (s_numFailed == 0)
+    printf("all checks passed\n");
+
+  return s_numFailed;
+}
@@ -0,0 +1,26 @@
+TEMPLATE = app
+
+TARGET = CQCheckTreeModelTest
+
+DEPENDPATH += .
+
+QT = core
+
+CONFIG += console
+
+#CONFIG += debug
+
+# Input
+SOURCES += \
+CQCheckTreeModelTest.cpp \
+
+DESTDIR     = .
+OBJECTS_DIR = .
+
+INCLUDEPATH += \
+../include \
+.
+
+unix:LIBS += \
+-L../lib \
+-lCQCheckTreeCore
@@ -1,10 +1,12 @@
 #include <CQCheckTreeTest.h>
+#include <CQCheckTreeRecorder.h>
 #ifdef USE_QT_APP
 #include <CQApp.h>
 #else
 #include <QApplication>
 #endif
 #include <QVBoxLayout>
+#include <QFile>
 #include <iostream>
 
 int
@@ -38,7 +40,11 @@ CQCheckTreeTest(QWidget *parent) :
 
   tree_ = new CQCheckTree(this);
 
+  tree_->setFilterVisible(true);
+
   for (int i = 0; i < 2; ++i) {
+    tree_->beginBulkUpdate();
+
     tree_->clear();
 
     tree_->setHeaders(QStringList() << "Item" << "Checked");
@@ -63,11 +69,19 @@ CQCheckTreeTest(QWidget *parent) :
 
     /* auto subCheck1 = */ tree_->addCheck(subSection1, "Eleven");
 
+    auto subSubSection1 = tree_->addSection(subSection1, "Sub Sub Section 1");
+
+    /* auto subSubCheck1 = */ tree_->addCheck(subSubSection1, "Twelve");
+
     /* auto check10 = */ tree_->addCheck("Ten");
+
+    tree_->endBulkUpdate();
   }
 
   connect(tree_, SIGNAL(itemChecked(const CQCheckTreeIndex &, bool)),
           this, SLOT(itemChecked(const CQCheckTreeIndex &, bool)));
+  connect(tree_, SIGNAL(itemsChecked(const QVector<CQCheckTreeIndex> &, bool)),
+          this, SLOT(itemsChecked(const QVector<CQCheckTreeIndex> &, bool)));
   connect(tree_, SIGNAL(sectionClicked(int)),
           this, SLOT(sectionClicked(int)));
   connect(tree_, SIGNAL(subSectionClicked(int, int)),
@@ -80,6 +94,27 @@ CQCheckTreeTest(QWidget *parent) :
   //layout->addStretch(1);
 
   tree_->fitColumns();
+
+  // record session for CQCheckTreeReplay
+  if (! qEnvironmentVariableIsEmpty("CQCHECKTREE_TRACE")) {
+    recorder_ = new CQCheckTreeRecorder(tree_);
+
+    recorder_->start();
+
+    connect(qApp, SIGNAL(aboutToQuit()), this, SLOT(saveTrace()));
+  }
+}
+
+void
+CQCheckTreeTest::
+saveTrace()
+{
+  recorder_->stop();
+
+  QFile file(QString::fromLocal8Bit(qgetenv("CQCHECKTREE_TRACE")));
+
+  if (! file.open(QIODevice::WriteOnly) || ! recorder_->trace().write(file))
+    std::cerr << "Failed to write trace\n";
 }
 
 void
@@ -98,6 +133,15 @@ itemChecked(const CQCheckTreeIndex &ind, bool /*checked*/)
   printState();
 }
 
+void
+CQCheckTreeTest::
+itemsChecked(const QVector<CQCheckTreeIndex> &inds, bool checked)
+{
+  std::cerr << inds.size() << " Items " << (checked ? "Checked" : "Unchecked") << "\n";
+
+  printState();
+}
+
 void
 CQCheckTreeTest::
 sectionClicked(int sectionInd)
@@ -136,6 +180,13 @@ printState()
 
   auto items = tree_->getCheckedItems();
 
-  for (const auto *item : items)
-    std::cerr << "  " << item->hierName().toStdString() << "\n";
+  QString name;
+
+  for (const auto &item : items) {
+    name.truncate(0);
+
+    item.appendHierName(name);
+
+    std::cerr << "  " << name.toStdString() << "\n";
+  }
 }
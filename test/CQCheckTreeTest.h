@@ -1,6 +1,8 @@
 #include <QWidget>
 #include <CQCheckTree.h>
 
+class CQCheckTreeRecorder;
+
 class CQCheckTreeTest : public QWidget {
   Q_OBJECT
 
@@ -9,6 +11,7 @@ class CQCheckTreeTest : public QWidget {
 
  private slots:
   void itemChecked(const CQCheckTreeIndex &ind, bool checked);
+  void itemsChecked(const QVector<CQCheckTreeIndex> &inds, bool checked);
 
   void sectionClicked(int sectionInd);
   void subSectionClicked(int sectionInd, int subSectionInd);
@@ -17,6 +20,9 @@ class CQCheckTreeTest : public QWidget {
 
   void printState();
 
+  void saveTrace();
+
  private:
-  CQCheckTree *tree_ { nullptr };
+  CQCheckTree         *tree_     { nullptr };
+  CQCheckTreeRecorder *recorder_ { nullptr };
 };
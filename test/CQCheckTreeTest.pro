@@ -24,4 +24,5 @@ INCLUDEPATH += \
 
 unix:LIBS += \
 -L../lib \
--lCQCheckTree
+-lCQCheckTree \
+-lCQCheckTreeCore